@@ -1,10 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <stdlib.h>
 #include <vector>
 
+#include "event_cache.hpp"
+#include "event_store.hpp"
+#include "mapped_file.hpp"
+#include "span.hpp"
+
 struct AEDAT
 {
   enum class EventType : uint16_t
@@ -137,14 +145,137 @@ struct AEDAT
     uint32_t eventValid;
   } __attribute__((packed));
 
+  // Reads the whole payload of a packet with a single call and returns the
+  // number of events in it.
+  static size_t read_payload(std::istream &fs, const Header &header,
+                             std::vector<char> &buffer)
+  {
+    const size_t packet_size =
+        static_cast<size_t>(header.eventCapacity) * header.eventSize;
+    buffer.resize(packet_size);
+    fs.read(buffer.data(), packet_size);
+
+    return std::min<size_t>(
+        header.eventNumber, fs.gcount() / std::max<size_t>(header.eventSize, 1));
+  }
+
+  // Reads a packet and copies its eventNumber slots into events.
+  template <typename T>
+  static void read_packet(std::istream &fs, const Header &header,
+                          std::vector<char> &buffer, std::vector<T> &events)
+  {
+    const size_t count = read_payload(fs, header, buffer);
+    const size_t offset = events.size();
+    events.resize(offset + count);
+
+    if (header.eventSize == sizeof(T))
+    {
+      std::memcpy(&events[offset], buffer.data(), count * sizeof(T));
+    }
+    else
+    {
+      const size_t size = std::min<size_t>(header.eventSize, sizeof(T));
+      for (size_t i = 0; i < count; i++)
+      {
+        std::memcpy(&events[offset + i], &buffer[i * header.eventSize], size);
+      }
+    }
+  }
+
+  // Reads a polarity packet and decodes its valid events into the columns
+  // of events.
+  void read_polarity_packet(std::istream &fs, const Header &header,
+                            std::vector<char> &buffer, EventStore &events)
+  {
+    if (header.eventSize != sizeof(PolarityEvent))
+    {
+      throw std::runtime_error("Unexpected polarity event size");
+    }
+
+    const size_t count = read_payload(fs, header, buffer);
+    decode_polarity_events(
+        reinterpret_cast<const PolarityEvent *>(buffer.data()), count,
+        timestamp_overflow(header, timestamp_wraps), events);
+  }
+
+  // Reads a packet of special events, counting the timestamp wraps in it.
+  void read_special_packet(std::istream &fs, const Header &header,
+                           std::vector<char> &buffer)
+  {
+    const size_t count = read_payload(fs, header, buffer);
+    timestamp_wraps += count_timestamp_wraps(header, buffer.data(), count);
+  }
+
+  // Returns the number of valid TIMESTAMP_WRAP events among the first count
+  // events of a special event packet.
+  static size_t count_timestamp_wraps(const Header &header, const char *data,
+                                      size_t count)
+  {
+    if (header.eventSize < sizeof(SpecialEvent))
+    {
+      return 0;
+    }
+
+    size_t wraps = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      SpecialEvent event;
+      std::memcpy(&event, data + i * header.eventSize, sizeof(event));
+      if (event.valid && static_cast<SpecialEventType>(event.type) ==
+                             SpecialEventType::TIMESTAMP_WRAP)
+      {
+        wraps++;
+      }
+    }
+    return wraps;
+  }
+
+  // Returns the timestamp overflow of a packet, falling back to the wraps
+  // counted so far for recordings that leave eventTSOverflow at zero.
+  static uint64_t timestamp_overflow(const Header &header,
+                                     uint64_t timestamp_wraps)
+  {
+    return std::max<uint64_t>(header.eventTSOverflow, timestamp_wraps);
+  }
+
+  // Returns the 64 bit timestamp of a 31 bit event timestamp, given the
+  // number of times the timestamp counter has overflowed before.
+  static int64_t full_timestamp(uint64_t overflow, uint32_t timestamp)
+  {
+    return static_cast<int64_t>(overflow << 31 | timestamp);
+  }
+
+  // Appends the valid events among count polarity events to events.
+  static void decode_polarity_events(const PolarityEvent *polarity_events,
+                                     size_t count, uint64_t overflow,
+                                     EventStore &events)
+  {
+    size_t offset = events.size();
+    events.resize(offset + count);
+
+    size_t idx = offset;
+    for (size_t i = 0; i < count; i++)
+    {
+      const auto &event = polarity_events[i];
+      events.t[idx] = full_timestamp(overflow, event.timestamp);
+      events.x[idx] = event.x;
+      events.y[idx] = event.y;
+      events.p[idx] = event.polarity;
+      idx += event.valid;
+    }
+    events.resize(idx);
+  }
+
   void load(const std::string &filename)
   {
     std::fstream fs;
     char line[128];
     Header header;
     std::string str = std::string(line);
+    std::vector<char> buffer;
 
-    fs.open(filename, std::fstream::in);
+    fs.open(filename, std::fstream::in | std::fstream::binary);
+    timestamp_wraps = 0;
 
     do
     {
@@ -154,54 +285,25 @@ struct AEDAT
 
     while (fs.read((char *)(&header), 28))
     {
-      if (header.eventTSOverflow != 0)
+      if (header.eventType == EventType::SPECIAL_EVENT)
       {
-        std::cout << "Unhandled TSOverflow "
-                  << static_cast<uint16_t>(header.eventTSOverflow) << std::endl;
+        read_special_packet(fs, header, buffer);
       }
-      if (header.eventType == EventType::POLARITY_EVENT)
+      else if (header.eventType == EventType::POLARITY_EVENT)
       {
-        PolarityEvent polarity_event;
-        for (size_t i = 0; i < header.eventNumber; i++)
-        {
-          fs.read((char *)(&polarity_event), header.eventSize);
-          polarity_events.push_back(polarity_event);
-        }
-        fs.ignore((header.eventCapacity - header.eventNumber) *
-                  header.eventSize);
+        read_polarity_packet(fs, header, buffer, events);
       }
       else if (header.eventType == EventType::IMU6_EVENT)
       {
-        IMU6Event imu6_event;
-        for (size_t i = 0; i < header.eventNumber; i++)
-        {
-          fs.read((char *)(&imu6_event), header.eventSize);
-          imu6_events.push_back(imu6_event);
-        }
-        fs.ignore((header.eventCapacity - header.eventNumber) *
-                  header.eventSize);
+        read_packet(fs, header, buffer, imu6_events);
       }
       else if (header.eventType == EventType::IMU9_EVENT)
       {
-        IMU9Event imu9_event;
-        for (size_t i = 0; i < header.eventNumber; i++)
-        {
-          fs.read((char *)(&imu9_event), header.eventSize);
-          imu9_events.push_back(imu9_event);
-        }
-        fs.ignore((header.eventCapacity - header.eventNumber) *
-                  header.eventSize);
+        read_packet(fs, header, buffer, imu9_events);
       }
       else if (header.eventType == EventType::SPIKE_EVENT)
       {
-        DynapSEEvent dyn_event;
-        for (size_t i = 0; i < header.eventNumber; i++)
-        {
-          fs.read((char *)(&dyn_event), header.eventSize);
-          dynapse_events.push_back(dyn_event);
-        }
-        fs.ignore((header.eventCapacity - header.eventNumber) *
-                  header.eventSize);
+        read_packet(fs, header, buffer, dynapse_events);
       }
       else
       {
@@ -210,7 +312,20 @@ struct AEDAT
         fs.ignore(header.eventCapacity * header.eventSize);
       }
     }
-    return;
+    events.index_time();
+  }
+
+  // Writes the polarity events to an EventCache, optionally with the
+  // segments of annotations over them.
+  void export_cache(const std::string &filename) const
+  {
+    EventCache::write(filename, events);
+  }
+
+  void export_cache(const std::string &filename,
+                    const Annotations &annotations) const
+  {
+    EventCache::write(filename, events, annotations);
   }
 
   AEDAT() {}
@@ -219,5 +334,135 @@ struct AEDAT
   std::vector<DynapSEEvent> dynapse_events;
   std::vector<IMU6Event> imu6_events;
   std::vector<IMU9Event> imu9_events;
-  std::vector<PolarityEvent> polarity_events;
-};
\ No newline at end of file
+  EventStore events;
+
+  // Timestamp wraps seen so far, for recordings that signal them only
+  // through special events and leave eventTSOverflow at zero.
+  uint64_t timestamp_wraps = 0;
+};
+
+// Memory mapped AEDAT 3.1 reader. Packets are discovered lazily and their
+// events are exposed as views into the mapping instead of being copied.
+// Timestamp wraps are counted while advancing, so packets must be visited in
+// order for their timestamps to match those of AEDAT::load.
+struct MappedAEDAT
+{
+  struct Packet
+  {
+    const AEDAT::Header *header;
+    const char *data;
+    // timestamp overflow of the events, see AEDAT::timestamp_overflow
+    uint64_t overflow;
+
+    template <typename T>
+    Span<T> events() const
+    {
+      if (header->eventSize != sizeof(T))
+      {
+        throw std::runtime_error("Unexpected event size");
+      }
+      // a corrupt eventNumber must not reach past the packet
+      return Span<T>{reinterpret_cast<const T *>(data),
+                     std::min(header->eventNumber, header->eventCapacity)};
+    }
+
+    // Returns the 64 bit timestamp of an event of this packet.
+    int64_t timestamp(const AEDAT::PolarityEvent &event) const
+    {
+      return AEDAT::full_timestamp(overflow, event.timestamp);
+    }
+
+    Span<AEDAT::PolarityEvent> polarity_events() const
+    {
+      if (header->eventType != AEDAT::EventType::POLARITY_EVENT)
+      {
+        return Span<AEDAT::PolarityEvent>();
+      }
+      return events<AEDAT::PolarityEvent>();
+    }
+  };
+
+  void open(const std::string &filename)
+  {
+    file.open(filename);
+
+    // skip the textual header, which ends with the #!END-HEADER line
+    const char *line = file.data();
+    first_packet = file.end();
+    while (line < file.end())
+    {
+      auto line_end = static_cast<const char *>(
+          std::memchr(line, '\n', file.end() - line));
+      line_end = line_end ? line_end + 1 : file.end();
+
+      if (std::string(line, line_end - line).rfind("#!END-HEADER", 0) == 0)
+      {
+        first_packet = line_end;
+        break;
+      }
+      line = line_end;
+    }
+    rewind();
+  }
+
+  // Advances to the next packet in the file, only touching its header and,
+  // for special event packets, the events to count timestamp wraps.
+  bool next(Packet &packet)
+  {
+    if (file.end() - cursor < static_cast<ptrdiff_t>(sizeof(AEDAT::Header)))
+    {
+      return false;
+    }
+
+    auto header = reinterpret_cast<const AEDAT::Header *>(cursor);
+    const size_t packet_size =
+        static_cast<size_t>(header->eventCapacity) * header->eventSize;
+    const char *data = cursor + sizeof(AEDAT::Header);
+
+    if (static_cast<size_t>(file.end() - data) < packet_size)
+    {
+      return false;
+    }
+
+    if (header->eventType == AEDAT::EventType::SPECIAL_EVENT)
+    {
+      timestamp_wraps += AEDAT::count_timestamp_wraps(
+          *header, data,
+          std::min(header->eventNumber, header->eventCapacity));
+    }
+
+    packet = Packet{header, data,
+                    AEDAT::timestamp_overflow(*header, timestamp_wraps)};
+    cursor = data + packet_size;
+    return true;
+  }
+
+  void rewind()
+  {
+    cursor = first_packet;
+    timestamp_wraps = 0;
+  }
+
+  std::vector<Packet> packets()
+  {
+    std::vector<Packet> result;
+    Packet packet;
+
+    rewind();
+    while (next(packet))
+    {
+      result.push_back(packet);
+    }
+    rewind();
+
+    return result;
+  }
+
+  MappedAEDAT() {}
+  MappedAEDAT(const std::string &filename) { open(filename); }
+
+  MappedFile file;
+  const char *first_packet = nullptr;
+  const char *cursor = nullptr;
+  uint64_t timestamp_wraps = 0;
+};
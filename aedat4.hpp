@@ -1,26 +1,34 @@
 #pragma once
 
+#include <algorithm>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <stdlib.h>
+#include <thread>
 #include <vector>
 
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
-
 #include <lz4.h>
 #include <lz4frame.h>
+#include <zstd.h>
 
 #include "aedat.hpp"
+#include "event_cache.hpp"
+#include "event_decode.hpp"
+#include "event_store.hpp"
 #include "events_generated.h"
 #include "file_data_table_generated.h"
 #include "frame_generated.h"
+#include "imu_store.hpp"
 #include "imus_generated.h"
 #include "ioheader_generated.h"
+#include "mapped_file.hpp"
 #include "rapidxml.hpp"
 #include "trigger_generated.h"
+#include "trigger_store.hpp"
 
 struct AEDAT4 {
   struct Frame {
@@ -65,25 +73,205 @@ struct AEDAT4 {
     return attributes;
   }
 
-  void load(const std::string &filename) {
-    struct stat stat_info;
+  // Location and time span of a packet, as stored in the FileDataTable.
+  struct DataTableEntry {
+    int64_t byte_offset;
+    int32_t stream_id;
+    int32_t size;
+    int64_t num_elements;
+    int64_t timestamp_start;
+    int64_t timestamp_end;
+  };
+
+  // A single decompressed packet. The typed views point into the
+  // decompression buffer of the reader and are only valid until the next
+  // packet is read.
+  struct Packet {
+    int32_t stream_id;
+    OutInfo::Type type;
+    const uint8_t *data;
+    size_t size;
+
+    const EventPacket *events() const {
+      return type == OutInfo::Type::EVTS ? GetSizePrefixedEventPacket(data)
+                                         : nullptr;
+    }
+
+    const ::Frame *frame() const {
+      return type == OutInfo::Type::FRME ? GetSizePrefixedFrame(data) : nullptr;
+    }
+
+    const ImuPacket *imus() const {
+      return type == OutInfo::Type::IMUS ? GetSizePrefixedImuPacket(data)
+                                         : nullptr;
+    }
+
+    const TriggerPacket *triggers() const {
+      return type == OutInfo::Type::TRIG ? GetSizePrefixedTriggerPacket(data)
+                                         : nullptr;
+    }
+  };
+
+  // Decompresses packets one at a time into a buffer that is reused for
+  // every packet. The buffer grows to fit the largest packet seen so far,
+  // using the content size from the frame header when it is present.
+  // Uncompressed packets are returned in place without copying.
+  struct Decompressor {
+    Decompressor() { create_context(); }
+
+    Decompressor(const Decompressor &) = delete;
+    Decompressor &operator=(const Decompressor &) = delete;
+
+    ~Decompressor() {
+      LZ4F_freeDecompressionContext(ctx);
+      ZSTD_freeDCtx(zstd_ctx);
+    }
+
+    const uint8_t *decompress(const char *src, size_t src_size,
+                              size_t &dst_size) {
+      switch (compression) {
+      case CompressionType_NONE:
+        dst_size = src_size;
+        return reinterpret_cast<const uint8_t *>(src);
+      case CompressionType_LZ4:
+      case CompressionType_LZ4_HIGH:
+        return decompress_lz4(src, src_size, dst_size);
+      case CompressionType_ZSTD:
+      case CompressionType_ZSTD_HIGH:
+        return decompress_zstd(src, src_size, dst_size);
+      }
+      throw std::runtime_error("Unsupported compression type");
+    }
+
+    const uint8_t *decompress_lz4(const char *src, size_t src_size,
+                                  size_t &dst_size) {
+      LZ4F_frameInfo_t frame_info;
+      size_t header_size = src_size;
+
+      auto ret = LZ4F_getFrameInfo(ctx, &frame_info, src, &header_size);
+      check(ret);
+      src += header_size;
+      src_size -= header_size;
+
+      if (frame_info.contentSize > buffer.size()) {
+        buffer.resize(frame_info.contentSize);
+      }
+
+      dst_size = 0;
+      do {
+        if (dst_size == buffer.size()) {
+          buffer.resize(std::max<size_t>(2 * buffer.size(), 1 << 16));
+        }
+
+        size_t out_size = buffer.size() - dst_size;
+        size_t in_size = src_size;
+        ret = LZ4F_decompress(ctx, &buffer[dst_size], &out_size, src,
+                              &in_size, nullptr);
+        check(ret);
+
+        dst_size += out_size;
+        src += in_size;
+        src_size -= in_size;
+
+        if (ret != 0 && src_size == 0 && out_size == 0) {
+          reset();
+          throw std::runtime_error("Truncated packet");
+        }
+      } while (ret != 0);
+
+      return buffer.data();
+    }
+
+    const uint8_t *decompress_zstd(const char *src, size_t src_size,
+                                   size_t &dst_size) {
+      if (zstd_ctx == nullptr) {
+        zstd_ctx = ZSTD_createDCtx();
+        if (zstd_ctx == nullptr) {
+          throw std::runtime_error("Failed to create ZSTD context");
+        }
+      }
+
+      auto content_size = ZSTD_getFrameContentSize(src, src_size);
+      if (content_size == ZSTD_CONTENTSIZE_ERROR) {
+        throw std::runtime_error("Decompression error: invalid ZSTD frame");
+      }
+
+      if (content_size != ZSTD_CONTENTSIZE_UNKNOWN) {
+        if (content_size > buffer.size()) {
+          buffer.resize(content_size);
+        }
+        dst_size = ZSTD_decompressDCtx(zstd_ctx, buffer.data(), buffer.size(),
+                                       src, src_size);
+        check_zstd(dst_size);
+        return buffer.data();
+      }
+
+      // the frame does not store its size, so stream it into the buffer
+      ZSTD_inBuffer input = {src, src_size, 0};
+      dst_size = 0;
+      size_t ret;
+      do {
+        if (dst_size == buffer.size()) {
+          buffer.resize(std::max<size_t>(2 * buffer.size(), 1 << 16));
+        }
+
+        ZSTD_outBuffer output = {buffer.data(), buffer.size(), dst_size};
+        ret = ZSTD_decompressStream(zstd_ctx, &output, &input);
+        check_zstd(ret);
+        dst_size = output.pos;
+
+        if (ret != 0 && input.pos == input.size && dst_size < buffer.size()) {
+          ZSTD_DCtx_reset(zstd_ctx, ZSTD_reset_session_only);
+          throw std::runtime_error("Truncated packet");
+        }
+      } while (ret != 0);
+
+      return buffer.data();
+    }
+
+    void create_context() {
+      LZ4F_errorCode_t lz4_error =
+          LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
+      if (LZ4F_isError(lz4_error)) {
+        throw std::runtime_error(std::string("Decompression error: ") +
+                                 LZ4F_getErrorName(lz4_error));
+      }
+    }
 
-    auto fd = open(filename.c_str(), O_RDONLY, 0);
+    // Drops a partially decoded frame so the next packet starts cleanly.
+    void reset() {
+      LZ4F_freeDecompressionContext(ctx);
+      create_context();
+    }
 
-    if (fd < 0) {
-      throw std::runtime_error("Failed to open file");
+    void check(size_t ret) {
+      if (LZ4F_isError(ret)) {
+        reset();
+        throw std::runtime_error(std::string("Decompression error: ") +
+                                 LZ4F_getErrorName(ret));
+      }
     }
 
-    if (fstat(fd, &stat_info)) {
-      throw std::runtime_error("Failed to stat file");
+    void check_zstd(size_t ret) {
+      if (ZSTD_isError(ret)) {
+        ZSTD_DCtx_reset(zstd_ctx, ZSTD_reset_session_only);
+        throw std::runtime_error(std::string("Decompression error: ") +
+                                 ZSTD_getErrorName(ret));
+      }
     }
 
-    char *data = static_cast<char *>(
-        mmap(NULL, stat_info.st_size, PROT_READ, MAP_SHARED, fd, 0));
-    char *buffer_start = data;
+    CompressionType compression = CompressionType_LZ4;
+    std::vector<uint8_t> buffer;
+    LZ4F_decompressionContext_t ctx;
+    ZSTD_DCtx *zstd_ctx = nullptr;
+  };
 
-    auto header = std::string(data, 14);
-    if (header != "#!AER-DAT4.0\r\n") {
+  // Maps the file and parses its header, without decompressing any packets.
+  void open(const std::string &filename) {
+    file.open(filename);
+    const char *data = file.data();
+
+    if (file.size() < 14 || std::string(data, 14) != "#!AER-DAT4.0\r\n") {
       throw std::runtime_error("Invalid AEDAT version");
     }
 
@@ -91,16 +279,19 @@ struct AEDAT4 {
 
     // find size of IOHeader (it is variable)
     flatbuffers::uoffset_t ioheader_offset =
-        *reinterpret_cast<flatbuffers::uoffset_t *>(data);
+        *reinterpret_cast<const flatbuffers::uoffset_t *>(data);
     const IOHeader *ioheader = GetSizePrefixedIOHeader(data);
 
     rapidxml::xml_document<> doc;
 
-    std::cout << ioheader->infoNode()->str() << std::endl;
+    // rapidxml parses in place, so it needs a copy that outlives the document
+    std::string info_node = ioheader->infoNode()->str();
+    std::cout << info_node << std::endl;
 
-    doc.parse<0>((char *)(ioheader->infoNode()->str().c_str()));
+    doc.parse<0>(&info_node[0]);
 
     // extract necessary data from XML
+    outinfos.clear();
     auto node = doc.first_node();
     for (rapidxml::xml_node<> *outinfo = node->first_node(); outinfo;
          outinfo = outinfo->next_sibling()) {
@@ -146,112 +337,362 @@ struct AEDAT4 {
                 << "}" << std::endl;
     }
 
-    size_t data_table_position = ioheader->dataTablePosition();
+    // packets and the data table are compressed with the same method
+    compression = ioheader->compression();
+    decompressor.compression = compression;
 
-    data += ioheader_offset + 4;
-    char *header_end = data;
+    // the data table follows the last packet, if it has been written at all
+    int64_t data_table_position = ioheader->dataTablePosition();
+    packets_end = data_table_position < 0
+                      ? file.end()
+                      : file.data() + data_table_position;
 
-    // we have to treat each packet according the compression method used,
-    // which can be found in ioheader->compression()
-    // assume LZ4 compression for now
+    first_packet = data + ioheader_offset + 4;
+    cursor = first_packet;
 
-    const size_t dst_size_fixed = 10000000;
-    std::vector<uint8_t> dst_buffer(dst_size_fixed);
-    LZ4F_decompressionContext_t ctx;
-    LZ4F_errorCode_t lz4_error =
-        LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
+    data_table.clear();
+    if (data_table_position >= 0) {
+      read_data_table(packets_end, file.end() - packets_end);
+    }
+  }
 
-    if (LZ4F_isError(lz4_error)) {
-      printf("Decompression error: %s\n", LZ4F_getErrorName(lz4_error));
-      return;
+  void read_data_table(const char *data, size_t size) {
+    size_t table_size;
+    auto file_data_table = GetSizePrefixedFileDataTable(
+        decompressor.decompress(data, size, table_size));
+
+    for (auto elem : *file_data_table->Table()) {
+      data_table.push_back(DataTableEntry{
+          elem->ByteOffset(), elem->PacketInfo()->StreamID(),
+          elem->PacketInfo()->Size(), elem->NumElements(),
+          elem->TimestampStart(), elem->TimestampEnd()});
     }
 
-    size_t dst_size = dst_size_fixed;
-    char *data_table_start = buffer_start + data_table_position;
-    size_t data_table_size = stat_info.st_size - data_table_position;
+    // Packets of different streams interleave, so their timestamps are not
+    // sorted. The running maximum of the end times and the running minimum
+    // of the start times from the back are, which makes both searchable.
+    data_table_max_end.resize(data_table.size());
+    data_table_min_start.resize(data_table.size());
+    for (size_t i = 0; i < data_table.size(); i++) {
+      data_table_max_end[i] =
+          i == 0 ? data_table[i].timestamp_end
+                 : std::max(data_table_max_end[i - 1],
+                            data_table[i].timestamp_end);
+    }
+    for (size_t i = data_table.size(); i-- > 0;) {
+      data_table_min_start[i] =
+          i == data_table.size() - 1
+              ? data_table[i].timestamp_start
+              : std::min(data_table_min_start[i + 1],
+                         data_table[i].timestamp_start);
+    }
+  }
 
-    auto ret = LZ4F_decompress(ctx, &dst_buffer[0], &dst_size, data_table_start,
-                               &data_table_size, nullptr);
-    if (LZ4F_isError(ret)) {
-      printf("Decompression error: %s\n", LZ4F_getErrorName(ret));
-      return;
+  // Returns the data table indices of all packets overlapping [start, end).
+  std::vector<size_t> packets_in_range(int64_t start, int64_t end) const {
+    std::vector<size_t> indices;
+
+    auto first = std::lower_bound(data_table_max_end.begin(),
+                                  data_table_max_end.end(), start) -
+                 data_table_max_end.begin();
+    auto last = std::lower_bound(data_table_min_start.begin(),
+                                 data_table_min_start.end(), end) -
+                data_table_min_start.begin();
+
+    for (auto idx = first; idx < last; idx++) {
+      if (data_table[idx].timestamp_end >= start &&
+          data_table[idx].timestamp_start < end) {
+        indices.push_back(idx);
+      }
     }
+    return indices;
+  }
 
-    auto file_data_table = GetSizePrefixedFileDataTable(&dst_buffer[0]);
+  // Returns the location of every packet, either from the data table or,
+  // if the file has none, by walking the packet headers.
+  std::vector<DataTableEntry> packet_index() const {
+    if (!data_table.empty()) {
+      return data_table;
+    }
 
-    for (auto elem : *file_data_table->Table()) {
-      // just here to illustrate access to the data
+    std::vector<DataTableEntry> index;
+    const char *data = first_packet;
+    while (packets_end - data >= 8) {
+      int32_t stream_id = *reinterpret_cast<const int32_t *>(data);
+      int32_t size = *reinterpret_cast<const int32_t *>(data + 4);
+      index.push_back(DataTableEntry{data - file.data(), stream_id, size, 0,
+                                     0, 0});
+      data += 8 + size;
     }
+    return index;
+  }
 
-    while (data < buffer_start + data_table_position) {
-      int32_t stream_id = *reinterpret_cast<int32_t *>(data);
-      data += 4;
-      size_t size = *reinterpret_cast<int32_t *>(data);
-      data += 4;
+  // Decompresses the packet described by entry with the given decompressor.
+  void read(const DataTableEntry &entry, Decompressor &decompressor,
+            Packet &packet) const {
+    const char *data = file.data() + entry.byte_offset + 8;
 
-      size_t dst_size = dst_size_fixed;
-      auto ret =
-          LZ4F_decompress(ctx, &dst_buffer[0], &dst_size, data, &size, nullptr);
-      data += size;
+    if (entry.byte_offset < 0 || entry.stream_id < 0 || entry.size < 0 ||
+        static_cast<size_t>(entry.stream_id) >= outinfos.size() ||
+        data + entry.size > packets_end) {
+      throw std::runtime_error("Invalid data table entry");
+    }
 
-      if (LZ4F_isError(ret)) {
-        printf("Decompression error: %s\n", LZ4F_getErrorName(ret));
-        return;
-      }
+    packet.stream_id = entry.stream_id;
+    packet.type = outinfos[entry.stream_id].type;
+    packet.data = decompressor.decompress(data, entry.size, packet.size);
+  }
 
-      switch (outinfos[stream_id].type) {
-      case OutInfo::Type::EVTS: {
-        auto event_packet = GetSizePrefixedEventPacket(&dst_buffer[0]);
-        for (auto event : *event_packet->elements()) {
-          polarity_events.push_back(
-              AEDAT::PolarityEvent{1, static_cast<uint32_t>(event->on()),
-                                   static_cast<uint32_t>(event->x()),
-                                   static_cast<uint32_t>(event->y()),
-                                   static_cast<uint32_t>(event->t())});
-        }
-        break;
+  // Decompresses the packet at the given data table index.
+  void read(size_t index, Packet &packet) {
+    read(data_table.at(index), decompressor, packet);
+  }
+
+  // Replaces the decoded events, frames, IMU samples and triggers with the
+  // ones in [start, end).
+  // Only packets overlapping the range are decompressed if the file has a
+  // data table, otherwise all packets are scanned.
+  void read_range(int64_t start, int64_t end) {
+    Packet packet;
+
+    events.clear();
+    frames.clear();
+    imus.clear();
+    triggers.clear();
+
+    if (data_table.empty()) {
+      rewind();
+      while (next(packet)) {
+        append(packet, start, end);
       }
-      case OutInfo::Type::FRME: {
-        Frame res;
-        auto frame_packet = GetSizePrefixedFrame(&dst_buffer[0]);
-        res.time = frame_packet->t();
-        res.width = frame_packet->width();
-        res.height = frame_packet->height();
+    } else {
+      for (auto idx : packets_in_range(start, end)) {
+        read(idx, packet);
+        append(packet, start, end);
+      }
+    }
+    events.index_time();
+    imus.index_time();
+    triggers.index();
+  }
 
-        // std::cout << frame_packet->offset_y() << std::endl;
+  // Decompresses the next packet of the file. Returns false once all packets
+  // have been read.
+  bool next(Packet &packet) {
+    // every packet starts with its stream id and compressed size
+    if (packets_end - cursor < 8) {
+      return false;
+    }
 
-        auto pixels = frame_packet->pixels()->data();
+    int32_t stream_id = *reinterpret_cast<const int32_t *>(cursor);
+    size_t size = *reinterpret_cast<const int32_t *>(cursor + 4);
+    const char *data = cursor + 8;
 
-        // res.pixels.reserve(res.width * res.height * 3);
+    if (stream_id < 0 || static_cast<size_t>(stream_id) >= outinfos.size() ||
+        static_cast<size_t>(packets_end - data) < size) {
+      throw std::runtime_error("Invalid packet header");
+    }
+    cursor = data + size;
 
-        for (int j = 0; j < res.height; j++) {
-          for (int i = 0; i < res.width; i++) {
-            res.pixels.push_back(pixels[i + j * res.width]);
-            res.pixels.push_back(pixels[i + j * res.width]);
-            res.pixels.push_back(pixels[i + j * res.width]);
-          }
-        }
+    packet.stream_id = stream_id;
+    packet.type = outinfos[stream_id].type;
+    packet.data = decompressor.decompress(data, size, packet.size);
+    return true;
+  }
+
+  void rewind() { cursor = first_packet; }
+
+  // Removes the elements appended to store after offset whose timestamps
+  // are outside [start, end). Elements within a packet are ordered, so the
+  // range to keep is contiguous.
+  template <typename Store>
+  static void trim(Store &store, size_t offset, int64_t start, int64_t end) {
+    auto first = store.t.begin() + offset;
+    size_t range_end =
+        std::lower_bound(first, store.t.end(), end) - store.t.begin();
+    store.erase(range_end, store.size());
+    size_t range_begin =
+        std::lower_bound(first, store.t.end(), start) - store.t.begin();
+    store.erase(offset, range_begin);
+  }
 
-        frames.push_back(res);
+  // Appends the content of a packet to the decoded events, frames, IMU
+  // samples and triggers, keeping only the elements with timestamps in
+  // [start, end).
+  void append(const Packet &packet,
+              int64_t start = std::numeric_limits<int64_t>::min(),
+              int64_t end = std::numeric_limits<int64_t>::max()) {
+    switch (packet.type) {
+    case OutInfo::Type::EVTS: {
+      size_t offset = events.size();
+      event_decode::decode(packet.events(), events.t, events.x, events.y,
+                           events.p);
+      trim(events, offset, start, end);
+      break;
+    }
+    case OutInfo::Type::FRME: {
+      Frame res;
+      auto frame_packet = packet.frame();
+      if (frame_packet->t() < start || frame_packet->t() >= end) {
         break;
       }
-      case OutInfo::Type::IMUS: {
-        auto imu_packet = GetSizePrefixedImuPacket(&dst_buffer[0]);
-        break;
+      res.time = frame_packet->t();
+      res.width = frame_packet->width();
+      res.height = frame_packet->height();
+
+      auto pixels = frame_packet->pixels()->data();
+
+      res.pixels.reserve(res.width * res.height * 3);
+
+      for (int j = 0; j < res.height; j++) {
+        for (int i = 0; i < res.width; i++) {
+          res.pixels.push_back(pixels[i + j * res.width]);
+          res.pixels.push_back(pixels[i + j * res.width]);
+          res.pixels.push_back(pixels[i + j * res.width]);
+        }
       }
-      case OutInfo::Type::TRIG: {
-        auto trigger_packet = GetSizePrefixedTriggerPacket(&dst_buffer[0]);
-        break;
+
+      frames.push_back(res);
+      break;
+    }
+    case OutInfo::Type::IMUS: {
+      size_t offset = imus.size();
+      imus.append(packet.imus());
+      trim(imus, offset, start, end);
+      break;
+    }
+    case OutInfo::Type::TRIG: {
+      size_t offset = triggers.size();
+      triggers.append(packet.triggers());
+      trim(triggers, offset, start, end);
+      break;
+    }
+    }
+  }
+
+  // Loads the whole recording. With more than one thread, the packets are
+  // split into contiguous ranges of about equal compressed size, which are
+  // decompressed and decoded concurrently and then concatenated in order.
+  void load(const std::string &filename, size_t num_threads = 1) {
+    Packet packet;
+
+    open(filename);
+
+    if (num_threads <= 1) {
+      while (next(packet)) {
+        append(packet);
       }
+      events.index_time();
+      imus.index_time();
+      triggers.index();
+      return;
+    }
+
+    auto index = packet_index();
+    size_t total_size = 0;
+    for (const auto &entry : index) {
+      total_size += entry.size;
+    }
+
+    std::vector<size_t> bounds(1, 0);
+    size_t range_size = 0;
+    for (size_t idx = 0; idx < index.size(); idx++) {
+      range_size += index[idx].size;
+      if (bounds.size() < num_threads &&
+          range_size * num_threads >= total_size * bounds.size()) {
+        bounds.push_back(idx + 1);
       }
     }
+    while (bounds.size() <= num_threads) {
+      bounds.push_back(index.size());
+    }
+
+    std::vector<AEDAT4> workers(num_threads);
+    std::vector<std::exception_ptr> errors(num_threads);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+        try {
+          Packet packet;
+          auto &worker = workers[t];
+          worker.decompressor.compression = compression;
+          for (size_t idx = bounds[t]; idx < bounds[t + 1]; idx++) {
+            read(index[idx], worker.decompressor, packet);
+            worker.append(packet);
+          }
+        } catch (...) {
+          errors[t] = std::current_exception();
+        }
+      });
+    }
+
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (auto &error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+
+    size_t num_events = events.size();
+    size_t num_frames = frames.size();
+    size_t num_imus = imus.size();
+    size_t num_triggers = triggers.size();
+    for (const auto &worker : workers) {
+      num_events += worker.events.size();
+      num_frames += worker.frames.size();
+      num_imus += worker.imus.size();
+      num_triggers += worker.triggers.size();
+    }
+    events.reserve(num_events);
+    frames.reserve(num_frames);
+    imus.reserve(num_imus);
+    triggers.reserve(num_triggers);
+
+    for (auto &worker : workers) {
+      events.append(worker.events);
+      std::move(worker.frames.begin(), worker.frames.end(),
+                std::back_inserter(frames));
+      imus.append(worker.imus);
+      triggers.append(worker.triggers);
+    }
+    events.index_time();
+    imus.index_time();
+    triggers.index();
+  }
+
+  // Writes the decoded events to an EventCache, optionally with the
+  // segments of annotations over them.
+  void export_cache(const std::string &filename) const {
+    EventCache::write(filename, events);
+  }
+
+  void export_cache(const std::string &filename,
+                    const Annotations &annotations) const {
+    EventCache::write(filename, events, annotations);
   }
 
   AEDAT4() {}
 
-  AEDAT4(const std::string &filename) { load(filename); }
+  AEDAT4(const std::string &filename, size_t num_threads = 1) {
+    load(filename, num_threads);
+  }
+
+  MappedFile file;
+  const char *first_packet = nullptr;
+  const char *packets_end = nullptr;
+  const char *cursor = nullptr;
+  CompressionType compression = CompressionType_NONE;
+  Decompressor decompressor;
 
   std::vector<OutInfo> outinfos;
+  std::vector<DataTableEntry> data_table;
+  std::vector<int64_t> data_table_max_end;
+  std::vector<int64_t> data_table_min_start;
   std::vector<Frame> frames;
-  std::vector<AEDAT::PolarityEvent> polarity_events;
+  EventStore events;
+  ImuStore imus;
+  TriggerStore triggers;
 };
@@ -0,0 +1,624 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <lz4frame.h>
+#include <zstd.h>
+
+#include "aedat4.hpp"
+#include "event_store.hpp"
+#include "events_generated.h"
+#include "file_data_table_generated.h"
+#include "frame_generated.h"
+#include "imu_store.hpp"
+#include "imus_generated.h"
+#include "ioheader_generated.h"
+#include "trigger_generated.h"
+#include "trigger_store.hpp"
+
+// Writes recordings in the AEDAT4 format. Streams are declared with
+// add_stream before the file is opened, since their descriptions are part
+// of the IOHeader. Packets are serialized as they are written and buffered,
+// and every batch is compressed on num_threads threads before it is written
+// out in order. close() appends the FileDataTable with the byte offset and
+// time span of every packet and rewrites the IOHeader to point at it, so the
+// file can be read by seeking to the packets of a time range.
+struct AEDAT4Writer {
+  struct ImuSample {
+    int64_t t;
+    float temperature;
+    float accelerometer_x;
+    float accelerometer_y;
+    float accelerometer_z;
+    float gyroscope_x;
+    float gyroscope_y;
+    float gyroscope_z;
+    float magnetometer_x;
+    float magnetometer_y;
+    float magnetometer_z;
+  };
+
+  struct TriggerSample {
+    int64_t t;
+    TriggerSource source;
+  };
+
+  // A serialized packet waiting to be compressed and written.
+  struct PendingPacket {
+    int32_t stream_id;
+    int64_t num_elements;
+    int64_t timestamp_start;
+    int64_t timestamp_end;
+    std::vector<uint8_t> data;
+    std::vector<char> compressed;
+  };
+
+  // Compresses packets into frames the AEDAT4 Decompressor reads. Each
+  // thread uses its own compressor, as ZSTD contexts are not shared.
+  struct Compressor {
+    Compressor(CompressionType compression) : compression(compression) {}
+
+    Compressor(const Compressor &) = delete;
+    Compressor &operator=(const Compressor &) = delete;
+
+    ~Compressor() { ZSTD_freeCCtx(zstd_ctx); }
+
+    void compress(const std::vector<uint8_t> &src, std::vector<char> &dst) {
+      switch (compression) {
+      case CompressionType_NONE:
+        dst.assign(src.begin(), src.end());
+        return;
+      case CompressionType_LZ4:
+      case CompressionType_LZ4_HIGH:
+        compress_lz4(src, dst);
+        return;
+      case CompressionType_ZSTD:
+      case CompressionType_ZSTD_HIGH:
+        compress_zstd(src, dst);
+        return;
+      }
+      throw std::runtime_error("Unsupported compression type");
+    }
+
+    void compress_lz4(const std::vector<uint8_t> &src,
+                      std::vector<char> &dst) {
+      LZ4F_preferences_t preferences = {};
+      // the content size lets the reader size its buffer up front
+      preferences.frameInfo.contentSize = src.size();
+      preferences.compressionLevel =
+          compression == CompressionType_LZ4_HIGH ? lz4_high_level : 0;
+
+      dst.resize(LZ4F_compressFrameBound(src.size(), &preferences));
+      auto ret = LZ4F_compressFrame(dst.data(), dst.size(), src.data(),
+                                    src.size(), &preferences);
+      if (LZ4F_isError(ret)) {
+        throw std::runtime_error(std::string("Compression error: ") +
+                                 LZ4F_getErrorName(ret));
+      }
+      dst.resize(ret);
+    }
+
+    void compress_zstd(const std::vector<uint8_t> &src,
+                       std::vector<char> &dst) {
+      if (zstd_ctx == nullptr) {
+        zstd_ctx = ZSTD_createCCtx();
+        if (zstd_ctx == nullptr) {
+          throw std::runtime_error("Failed to create ZSTD context");
+        }
+      }
+
+      dst.resize(ZSTD_compressBound(src.size()));
+      auto ret = ZSTD_compressCCtx(
+          zstd_ctx, dst.data(), dst.size(), src.data(), src.size(),
+          compression == CompressionType_ZSTD_HIGH ? zstd_high_level
+                                                   : zstd_level);
+      if (ZSTD_isError(ret)) {
+        throw std::runtime_error(std::string("Compression error: ") +
+                                 ZSTD_getErrorName(ret));
+      }
+      dst.resize(ret);
+    }
+
+    static constexpr int lz4_high_level = 9;
+    static constexpr int zstd_level = 3;
+    static constexpr int zstd_high_level = 19;
+
+    CompressionType compression;
+    ZSTD_CCtx *zstd_ctx = nullptr;
+  };
+
+  // Declares a stream and returns its id. All streams have to be added
+  // before the file is opened.
+  int32_t add_stream(AEDAT4::OutInfo::Type type, int size_x = 0,
+                     int size_y = 0) {
+    if (fs.is_open()) {
+      throw std::runtime_error("Streams must be added before opening");
+    }
+
+    AEDAT4::OutInfo info;
+    info.name = static_cast<int>(outinfos.size());
+    info.size_x = size_x;
+    info.size_y = size_y;
+    info.type = type;
+    outinfos.push_back(info);
+    return info.name;
+  }
+
+  // Creates the file and writes its IOHeader. The data table position is
+  // left at -1 until close(), so an unfinished file is still readable by
+  // scanning its packets.
+  void open(const std::string &filename,
+            CompressionType compression = CompressionType_LZ4,
+            size_t num_threads = 1) {
+    if (fs.is_open()) {
+      close();
+    }
+
+    this->compression = compression;
+    this->num_threads = std::max<size_t>(num_threads, 1);
+    for (auto &info : outinfos) {
+      info.compression = compression_name(compression);
+    }
+    pending.clear();
+    data_table.clear();
+
+    fs.open(filename,
+            std::ofstream::binary | std::ofstream::trunc | std::ofstream::out);
+    if (!fs) {
+      throw std::runtime_error("Failed to create " + filename);
+    }
+
+    fs.write("#!AER-DAT4.0\r\n", 14);
+    header = io_header(-1);
+    fs.write(reinterpret_cast<const char *>(header.data()), header.size());
+    position = 14 + header.size();
+  }
+
+  // Writes the events [begin, end) of a sorted EventStore, split into
+  // packets of at most events_per_packet events.
+  void write_events(int32_t stream_id, const EventStore &events, size_t begin,
+                    size_t end) {
+    check_stream(stream_id, AEDAT4::OutInfo::Type::EVTS);
+    check_range(begin, end, events.size());
+    if (events_per_packet == 0) {
+      throw std::runtime_error("events_per_packet must be positive");
+    }
+
+    for (size_t first = begin; first < end; first += events_per_packet) {
+      const size_t last = std::min(end, first + events_per_packet);
+      pending.push_back(event_packet(stream_id, events, first, last));
+      flush_full_batch();
+    }
+  }
+
+  void write_events(int32_t stream_id, const EventStore &events) {
+    write_events(stream_id, events, 0, events.size());
+  }
+
+  // Writes a grayscale frame. The pixels are either one byte per pixel or,
+  // as decoded by AEDAT4, three equal bytes per pixel.
+  void write_frame(int32_t stream_id, const AEDAT4::Frame &frame) {
+    check_stream(stream_id, AEDAT4::OutInfo::Type::FRME);
+
+    const size_t num_pixels = static_cast<size_t>(frame.width) * frame.height;
+    std::vector<uint8_t> pixels;
+    if (frame.pixels.size() == num_pixels) {
+      pixels = frame.pixels;
+    } else if (frame.pixels.size() == 3 * num_pixels) {
+      pixels.resize(num_pixels);
+      for (size_t idx = 0; idx < num_pixels; idx++) {
+        pixels[idx] = frame.pixels[3 * idx];
+      }
+    } else {
+      throw std::runtime_error("Frame size does not match its pixels");
+    }
+
+    flatbuffers::FlatBufferBuilder fbb;
+    fbb.FinishSizePrefixed(CreateFrameDirect(
+        fbb, frame.time, frame.time, frame.time, frame.time, frame.time,
+        FrameFormat_Gray, frame.width, frame.height, 0, 0, &pixels));
+    add_packet(stream_id, fbb, 1, frame.time, frame.time);
+  }
+
+  void write_imus(int32_t stream_id, const std::vector<ImuSample> &imus) {
+    check_stream(stream_id, AEDAT4::OutInfo::Type::IMUS);
+    if (imus.empty()) {
+      return;
+    }
+
+    flatbuffers::FlatBufferBuilder fbb;
+    std::vector<flatbuffers::Offset<Imu>> elements;
+    elements.reserve(imus.size());
+    for (const auto &imu : imus) {
+      elements.push_back(CreateImu(
+          fbb, imu.t, imu.temperature, imu.accelerometer_x,
+          imu.accelerometer_y, imu.accelerometer_z, imu.gyroscope_x,
+          imu.gyroscope_y, imu.gyroscope_z, imu.magnetometer_x,
+          imu.magnetometer_y, imu.magnetometer_z));
+    }
+    fbb.FinishSizePrefixed(CreateImuPacketDirect(fbb, &elements));
+    add_packet(stream_id, fbb, imus.size(), imus.front().t, imus.back().t);
+  }
+
+  // Writes the samples [begin, end) of an ImuStore as a single packet.
+  void write_imus(int32_t stream_id, const ImuStore &imus, size_t begin,
+                  size_t end) {
+    check_range(begin, end, imus.size());
+    std::vector<ImuSample> samples;
+    samples.reserve(end - begin);
+    for (size_t idx = begin; idx < end; idx++) {
+      samples.push_back(ImuSample{
+          imus.t[idx], imus.temperature[idx], imus.accelerometer_x[idx],
+          imus.accelerometer_y[idx], imus.accelerometer_z[idx],
+          imus.gyroscope_x[idx], imus.gyroscope_y[idx], imus.gyroscope_z[idx],
+          imus.magnetometer_x[idx], imus.magnetometer_y[idx],
+          imus.magnetometer_z[idx]});
+    }
+    write_imus(stream_id, samples);
+  }
+
+  void write_triggers(int32_t stream_id,
+                      const std::vector<TriggerSample> &triggers) {
+    check_stream(stream_id, AEDAT4::OutInfo::Type::TRIG);
+    if (triggers.empty()) {
+      return;
+    }
+
+    flatbuffers::FlatBufferBuilder fbb;
+    std::vector<flatbuffers::Offset<Trigger>> elements;
+    elements.reserve(triggers.size());
+    for (const auto &trigger : triggers) {
+      elements.push_back(CreateTrigger(fbb, trigger.t, trigger.source));
+    }
+    fbb.FinishSizePrefixed(CreateTriggerPacketDirect(fbb, &elements));
+    add_packet(stream_id, fbb, triggers.size(), triggers.front().t,
+               triggers.back().t);
+  }
+
+  // Writes the triggers [begin, end) of a TriggerStore as a single packet.
+  void write_triggers(int32_t stream_id, const TriggerStore &triggers,
+                      size_t begin, size_t end) {
+    check_range(begin, end, triggers.size());
+    std::vector<TriggerSample> samples;
+    samples.reserve(end - begin);
+    for (size_t idx = begin; idx < end; idx++) {
+      samples.push_back(TriggerSample{
+          triggers.t[idx], static_cast<TriggerSource>(triggers.source[idx])});
+    }
+    write_triggers(stream_id, samples);
+  }
+
+  // Copies a packet decoded by AEDAT4 without parsing it into a new
+  // representation, e.g. to pass frames and IMU samples through a filter
+  // that only changes the events. The packet must belong to a stream of the
+  // same id and type in this file.
+  void write_packet(const AEDAT4::Packet &packet) {
+    check_stream(packet.stream_id, packet.type);
+
+    int64_t num_elements = 0;
+    int64_t timestamp_start = 0;
+    int64_t timestamp_end = 0;
+    auto time_span = [&](auto elements) {
+      if (elements != nullptr && elements->size() > 0) {
+        num_elements = elements->size();
+        timestamp_start = elements->Get(0)->t();
+        timestamp_end = elements->Get(elements->size() - 1)->t();
+      }
+    };
+
+    switch (packet.type) {
+    case AEDAT4::OutInfo::Type::EVTS:
+      time_span(packet.events()->elements());
+      break;
+    case AEDAT4::OutInfo::Type::FRME:
+      num_elements = 1;
+      timestamp_start = timestamp_end = packet.frame()->t();
+      break;
+    case AEDAT4::OutInfo::Type::IMUS:
+      time_span(packet.imus()->elements());
+      break;
+    case AEDAT4::OutInfo::Type::TRIG:
+      time_span(packet.triggers()->elements());
+      break;
+    }
+
+    pending.push_back(PendingPacket{
+        packet.stream_id, num_elements, timestamp_start, timestamp_end,
+        std::vector<uint8_t>(packet.data, packet.data + packet.size), {}});
+    flush_full_batch();
+  }
+
+  // Serializes the events [begin, end) into a single packet, which can be
+  // compressed on any thread and passed to write_compressed.
+  static PendingPacket event_packet(int32_t stream_id, const EventStore &events,
+                                    size_t begin, size_t end) {
+    std::vector<Event> elements;
+    elements.reserve(end - begin);
+    for (size_t idx = begin; idx < end; idx++) {
+      elements.emplace_back(events.t[idx], events.x[idx], events.y[idx],
+                            events.p[idx] != 0);
+    }
+
+    flatbuffers::FlatBufferBuilder fbb;
+    fbb.FinishSizePrefixed(CreateEventPacketDirect(fbb, &elements));
+    return PendingPacket{
+        stream_id,
+        static_cast<int64_t>(end - begin),
+        begin < end ? events.t[begin] : 0,
+        begin < end ? events.t[end - 1] : 0,
+        std::vector<uint8_t>(fbb.GetBufferPointer(),
+                             fbb.GetBufferPointer() + fbb.GetSize()),
+        {}};
+  }
+
+  // Writes a packet whose compressed data was filled in by the caller with
+  // a Compressor of the same type, after any buffered packets.
+  void write_compressed(const PendingPacket &packet) {
+    if (!fs.is_open() || packet.stream_id < 0 ||
+        static_cast<size_t>(packet.stream_id) >= outinfos.size()) {
+      throw std::runtime_error("Packet does not match stream " +
+                               std::to_string(packet.stream_id));
+    }
+    flush();
+    append(packet);
+  }
+
+  // Compresses and writes all buffered packets.
+  void flush() {
+    compress_pending();
+    for (const auto &packet : pending) {
+      append(packet);
+    }
+    pending.clear();
+  }
+
+  // Writes the remaining packets and the FileDataTable, then points the
+  // IOHeader at the table. The header keeps its size, as every field is
+  // stored even when it holds the default value.
+  void close() {
+    if (!fs.is_open()) {
+      return;
+    }
+    flush();
+
+    flatbuffers::FlatBufferBuilder fbb;
+    std::vector<flatbuffers::Offset<FileDataDefinition>> definitions;
+    definitions.reserve(data_table.size());
+    for (const auto &entry : data_table) {
+      PacketHeader packet_header(entry.stream_id, entry.size);
+      definitions.push_back(CreateFileDataDefinition(
+          fbb, entry.byte_offset, &packet_header, entry.num_elements,
+          entry.timestamp_start, entry.timestamp_end));
+    }
+    fbb.FinishSizePrefixed(CreateFileDataTableDirect(fbb, &definitions));
+
+    std::vector<char> table;
+    Compressor compressor(compression);
+    compressor.compress(std::vector<uint8_t>(fbb.GetBufferPointer(),
+                                             fbb.GetBufferPointer() +
+                                                 fbb.GetSize()),
+                        table);
+    fs.write(table.data(), table.size());
+
+    auto final_header = io_header(position);
+    if (final_header.size() != header.size()) {
+      throw std::runtime_error("IOHeader changed size");
+    }
+    fs.seekp(14);
+    fs.write(reinterpret_cast<const char *>(final_header.data()),
+             final_header.size());
+
+    fs.close();
+    if (!fs) {
+      throw std::runtime_error("Failed to write data table");
+    }
+  }
+
+  static CompressionType to_compression(const std::string &str) {
+    for (auto compression :
+         {CompressionType_NONE, CompressionType_LZ4, CompressionType_LZ4_HIGH,
+          CompressionType_ZSTD, CompressionType_ZSTD_HIGH}) {
+      if (str == compression_name(compression)) {
+        return compression;
+      }
+    }
+    throw std::runtime_error("Unsupported compression type " + str);
+  }
+
+  AEDAT4Writer() {}
+
+  AEDAT4Writer(const AEDAT4Writer &) = delete;
+  AEDAT4Writer &operator=(const AEDAT4Writer &) = delete;
+
+  // Finishes the file if close() was not called. Errors are dropped here,
+  // call close() to see them.
+  ~AEDAT4Writer() {
+    try {
+      close();
+    } catch (...) {
+    }
+  }
+
+  std::vector<AEDAT4::OutInfo> outinfos;
+  std::vector<AEDAT4::DataTableEntry> data_table;
+  CompressionType compression = CompressionType_LZ4;
+  size_t num_threads = 1;
+  size_t events_per_packet = 1 << 14;
+  size_t packets_per_batch = 64;
+
+private:
+  static const char *compression_name(CompressionType compression) {
+    switch (compression) {
+    case CompressionType_NONE:
+      return "NONE";
+    case CompressionType_LZ4:
+      return "LZ4";
+    case CompressionType_LZ4_HIGH:
+      return "LZ4_HIGH";
+    case CompressionType_ZSTD:
+      return "ZSTD";
+    case CompressionType_ZSTD_HIGH:
+      return "ZSTD_HIGH";
+    }
+    throw std::runtime_error("Unsupported compression type");
+  }
+
+  static const char *type_name(AEDAT4::OutInfo::Type type) {
+    switch (type) {
+    case AEDAT4::OutInfo::Type::EVTS:
+      return "EVTS";
+    case AEDAT4::OutInfo::Type::FRME:
+      return "FRME";
+    case AEDAT4::OutInfo::Type::IMUS:
+      return "IMUS";
+    case AEDAT4::OutInfo::Type::TRIG:
+      return "TRIG";
+    }
+    throw std::runtime_error("unexpected event type");
+  }
+
+  // Describes the streams in the XML layout AEDAT4::open parses.
+  std::string info_node() const {
+    std::string xml = "<dv version=\"2.0\"><node name=\"outInfo\" "
+                      "path=\"/mainModule/output/\">";
+    for (const auto &info : outinfos) {
+      const std::string path = "/" + std::to_string(info.name) + "/";
+      xml += "<node name=\"" + std::to_string(info.name) + "\" path=\"" +
+             path + "\">";
+      xml += "<attr key=\"compression\" type=\"string\">" + info.compression +
+             "</attr>";
+      xml += "<attr key=\"typeIdentifier\" type=\"string\">" +
+             std::string(type_name(info.type)) + "</attr>";
+      if (info.size_x > 0 && info.size_y > 0) {
+        xml += "<node name=\"info\" path=\"" + path + "info/\">";
+        xml += "<attr key=\"sizeX\" type=\"int\">" +
+               std::to_string(info.size_x) + "</attr>";
+        xml += "<attr key=\"sizeY\" type=\"int\">" +
+               std::to_string(info.size_y) + "</attr>";
+        xml += "</node>";
+      }
+      xml += "</node>";
+    }
+    xml += "</node></dv>";
+    return xml;
+  }
+
+  std::vector<uint8_t> io_header(int64_t data_table_position) const {
+    flatbuffers::FlatBufferBuilder fbb;
+    fbb.ForceDefaults(true);
+    auto info = fbb.CreateString(info_node());
+    fbb.FinishSizePrefixed(
+        CreateIOHeader(fbb, compression, data_table_position, info));
+    return std::vector<uint8_t>(fbb.GetBufferPointer(),
+                                fbb.GetBufferPointer() + fbb.GetSize());
+  }
+
+  void check_stream(int32_t stream_id, AEDAT4::OutInfo::Type type) const {
+    if (!fs.is_open()) {
+      throw std::runtime_error("Writer is not open");
+    }
+    if (stream_id < 0 || static_cast<size_t>(stream_id) >= outinfos.size() ||
+        outinfos[stream_id].type != type) {
+      throw std::runtime_error("Packet does not match stream " +
+                               std::to_string(stream_id));
+    }
+  }
+
+  static void check_range(size_t begin, size_t end, size_t size) {
+    if (begin > end || end > size) {
+      throw std::runtime_error("Invalid range [" + std::to_string(begin) +
+                               ", " + std::to_string(end) + ")");
+    }
+  }
+
+  void add_packet(int32_t stream_id, flatbuffers::FlatBufferBuilder &fbb,
+                  int64_t num_elements, int64_t timestamp_start,
+                  int64_t timestamp_end) {
+    pending.push_back(PendingPacket{
+        stream_id, num_elements, timestamp_start, timestamp_end,
+        std::vector<uint8_t>(fbb.GetBufferPointer(),
+                             fbb.GetBufferPointer() + fbb.GetSize()),
+        {}});
+    flush_full_batch();
+  }
+
+  void append(const PendingPacket &packet) {
+    if (packet.compressed.size() >
+        static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+      throw std::runtime_error("Packet too large");
+    }
+    const int32_t size = static_cast<int32_t>(packet.compressed.size());
+
+    data_table.push_back(AEDAT4::DataTableEntry{
+        position, packet.stream_id, size, packet.num_elements,
+        packet.timestamp_start, packet.timestamp_end});
+
+    fs.write(reinterpret_cast<const char *>(&packet.stream_id),
+             sizeof(packet.stream_id));
+    fs.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    fs.write(packet.compressed.data(), size);
+    position += 8 + size;
+
+    if (!fs) {
+      throw std::runtime_error("Failed to write packets");
+    }
+  }
+
+  void flush_full_batch() {
+    if (pending.size() >= packets_per_batch * num_threads) {
+      flush();
+    }
+  }
+
+  // Compresses the buffered packets, handing them out to the threads one at
+  // a time so that large and small packets balance out.
+  void compress_pending() {
+    const size_t count = std::min(num_threads, pending.size());
+    if (count <= 1) {
+      Compressor compressor(compression);
+      for (auto &packet : pending) {
+        compressor.compress(packet.data, packet.compressed);
+      }
+      return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < count; t++) {
+      threads.emplace_back([&, t] {
+        try {
+          Compressor compressor(compression);
+          for (size_t idx = next++; idx < pending.size(); idx = next++) {
+            compressor.compress(pending[idx].data, pending[idx].compressed);
+          }
+        } catch (...) {
+          errors[t] = std::current_exception();
+        }
+      });
+    }
+
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (auto &error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+  }
+
+  std::ofstream fs;
+  std::vector<uint8_t> header;
+  int64_t position = 0;
+  std::vector<PendingPacket> pending;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "event_store.hpp"
+#include "mapped_file.hpp"
+
+// Labelled time intervals of a recording, such as the gestures of a DVS
+// Gesture recording. The intervals are sorted and do not overlap, and can be
+// resolved to the range of events they cover in any EventStore.
+struct Annotations {
+  struct Annotation {
+    uint32_t label;
+    int64_t start_time;
+    int64_t end_time;
+  };
+
+  // Range of events [begin, end) covered by an annotation.
+  struct Segment {
+    uint32_t label;
+    int64_t start_time;
+    size_t begin;
+    size_t end;
+
+    size_t size() const { return end - begin; }
+  };
+
+  // Reads annotations from a CSV file with one label,start,end row per
+  // line, in microseconds. A first line that does not start with a number is
+  // taken as the column names. Malformed, unordered or overlapping rows are
+  // reported with their line number.
+  void read_csv(const std::string &filename) {
+    MappedFile file(filename);
+    annotations.clear();
+
+    const char *line = file.data();
+    size_t line_number = 0;
+    while (line < file.end()) {
+      auto line_end = static_cast<const char *>(
+          std::memchr(line, '\n', file.end() - line));
+      if (line_end == nullptr) {
+        line_end = file.end();
+      }
+      line_number++;
+
+      const char *begin = line;
+      const char *end = line_end;
+      line = line_end + 1;
+
+      trim(begin, end);
+      if (begin == end) {
+        continue;
+      }
+      if (line_number == 1 && !is_number(*begin)) {
+        continue;
+      }
+
+      Annotation annotation;
+      int64_t label;
+      if (!parse_field(begin, end, label, ',') ||
+          !parse_field(begin, end, annotation.start_time, ',') ||
+          !parse_field(begin, end, annotation.end_time, '\0') || label < 0 ||
+          label > UINT32_MAX) {
+        error(filename, line_number, "malformed row");
+      }
+      annotation.label = static_cast<uint32_t>(label);
+
+      if (annotation.end_time < annotation.start_time) {
+        error(filename, line_number, "row ends before it starts");
+      }
+      if (!annotations.empty()) {
+        if (annotation.start_time < annotations.back().start_time) {
+          error(filename, line_number, "row starts before the previous row");
+        }
+        if (annotation.start_time < annotations.back().end_time) {
+          error(filename, line_number, "row overlaps the previous row");
+        }
+      }
+      annotations.push_back(annotation);
+    }
+  }
+
+  // Returns the non-empty ranges of events covered by the annotations, found
+  // by binary search on the sorted timestamps t.
+  std::vector<Segment> segments(const std::vector<int64_t> &t) const {
+    std::vector<Segment> result;
+    auto begin = t.begin();
+    for (const auto &annotation : annotations) {
+      begin = std::lower_bound(begin, t.end(), annotation.start_time);
+      auto end = std::lower_bound(begin, t.end(), annotation.end_time);
+      if (begin != end) {
+        result.push_back(Segment{annotation.label, annotation.start_time,
+                                 static_cast<size_t>(begin - t.begin()),
+                                 static_cast<size_t>(end - t.begin())});
+      }
+    }
+    return result;
+  }
+
+  std::vector<Segment> segments(const EventStore &events) const {
+    return segments(events.t);
+  }
+
+  size_t size() const { return annotations.size(); }
+  bool empty() const { return annotations.empty(); }
+
+  Annotations() {}
+  Annotations(const std::string &filename) { read_csv(filename); }
+
+  std::vector<Annotation> annotations;
+
+private:
+  static bool is_number(char c) { return (c >= '0' && c <= '9') || c == '-'; }
+
+  static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+  }
+
+  static void trim(const char *&begin, const char *&end) {
+    while (begin < end && is_space(*begin)) {
+      begin++;
+    }
+    while (end > begin && is_space(end[-1])) {
+      end--;
+    }
+  }
+
+  // Parses an integer field terminated by separator, or by the end of the
+  // line if separator is '\0', and advances begin past it.
+  static bool parse_field(const char *&begin, const char *end, int64_t &value,
+                          char separator) {
+    const char *field_end =
+        separator ? static_cast<const char *>(
+                        std::memchr(begin, separator, end - begin))
+                  : end;
+    if (field_end == nullptr) {
+      return false;
+    }
+
+    const char *field_begin = begin;
+    const char *value_end = field_end;
+    trim(field_begin, value_end);
+    auto result = std::from_chars(field_begin, value_end, value);
+    if (result.ec != std::errc() || result.ptr != value_end ||
+        field_begin == value_end) {
+      return false;
+    }
+
+    begin = separator ? field_end + 1 : field_end;
+    return true;
+  }
+
+  [[noreturn]] static void error(const std::string &filename,
+                                 size_t line_number, const char *message) {
+    throw std::runtime_error(filename + ":" + std::to_string(line_number) +
+                             ": " + message);
+  }
+};
@@ -0,0 +1,237 @@
+#include "aedat.hpp"
+#include "aedat4.hpp"
+#include "event_decode.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Writes a synthetic AEDAT 3.1 recording consisting of polarity packets.
+void write_aedat31(const std::string &filename, size_t num_packets,
+                   size_t packet_events) {
+  std::ofstream fs(filename, std::ofstream::binary);
+  fs << "#!AER-DAT3.1\r\n#!END-HEADER\r\n";
+
+  std::vector<AEDAT::PolarityEvent> events(packet_events);
+  uint32_t timestamp = 0;
+  for (size_t packet = 0; packet < num_packets; packet++) {
+    AEDAT::Header header{AEDAT::EventType::POLARITY_EVENT,
+                         1,
+                         sizeof(AEDAT::PolarityEvent),
+                         4,
+                         0,
+                         static_cast<uint32_t>(packet_events),
+                         static_cast<uint32_t>(packet_events),
+                         static_cast<uint32_t>(packet_events)};
+    for (size_t i = 0; i < packet_events; i++) {
+      events[i] = AEDAT::PolarityEvent{1, static_cast<uint32_t>(i & 1),
+                                       static_cast<uint32_t>(i % 128),
+                                       static_cast<uint32_t>((i / 128) % 128),
+                                       timestamp++};
+    }
+    fs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    fs.write(reinterpret_cast<const char *>(events.data()),
+             events.size() * sizeof(AEDAT::PolarityEvent));
+  }
+}
+
+// Reference loader reading every polarity event with its own call, as
+// AEDAT::load did before packets were read in bulk.
+size_t load_per_event(const std::string &filename) {
+  std::fstream fs;
+  char line[128];
+  AEDAT::Header header;
+  std::vector<AEDAT::PolarityEvent> polarity_events;
+
+  fs.open(filename, std::fstream::in | std::fstream::binary);
+  do {
+    fs.getline(line, 128);
+  } while (std::string(line).rfind("#!END-HEADER", 0) != 0);
+
+  while (fs.read((char *)(&header), 28)) {
+    AEDAT::PolarityEvent polarity_event;
+    for (size_t i = 0; i < header.eventNumber; i++) {
+      fs.read((char *)(&polarity_event), header.eventSize);
+      polarity_events.push_back(polarity_event);
+    }
+    fs.ignore((header.eventCapacity - header.eventNumber) * header.eventSize);
+  }
+  return polarity_events.size();
+}
+
+// Serializes a synthetic AEDAT4 event packet of the given size.
+std::vector<uint8_t> event_packet(size_t num_events) {
+  flatbuffers::FlatBufferBuilder fbb;
+  std::vector<Event> events;
+  events.reserve(num_events);
+  for (size_t i = 0; i < num_events; i++) {
+    events.emplace_back(static_cast<int64_t>(i), i % 346, (i / 346) % 260,
+                        i & 1);
+  }
+  fbb.FinishSizePrefixed(CreateEventPacketDirect(fbb, &events));
+  return std::vector<uint8_t>(fbb.GetBufferPointer(),
+                              fbb.GetBufferPointer() + fbb.GetSize());
+}
+
+std::vector<char> compress(const std::vector<uint8_t> &src,
+                           CompressionType compression) {
+  std::vector<char> dst;
+  switch (compression) {
+  case CompressionType_NONE:
+    dst.assign(src.begin(), src.end());
+    break;
+  case CompressionType_LZ4:
+  case CompressionType_LZ4_HIGH: {
+    LZ4F_preferences_t preferences = {};
+    preferences.compressionLevel =
+        compression == CompressionType_LZ4_HIGH ? 9 : 0;
+    dst.resize(LZ4F_compressFrameBound(src.size(), &preferences));
+    auto ret = LZ4F_compressFrame(dst.data(), dst.size(), src.data(),
+                                  src.size(), &preferences);
+    if (LZ4F_isError(ret)) {
+      throw std::runtime_error(std::string("Compression error: ") +
+                               LZ4F_getErrorName(ret));
+    }
+    dst.resize(ret);
+    break;
+  }
+  case CompressionType_ZSTD:
+  case CompressionType_ZSTD_HIGH: {
+    auto ctx = ZSTD_createCCtx();
+    dst.resize(ZSTD_compressBound(src.size()));
+    auto ret = ZSTD_compressCCtx(
+        ctx, dst.data(), dst.size(), src.data(), src.size(),
+        compression == CompressionType_ZSTD_HIGH ? 19 : 3);
+    ZSTD_freeCCtx(ctx);
+    if (ZSTD_isError(ret)) {
+      throw std::runtime_error(std::string("Compression error: ") +
+                               ZSTD_getErrorName(ret));
+    }
+    dst.resize(ret);
+    break;
+  }
+  }
+  return dst;
+}
+
+// Measures how fast a packet compressed with each codec is decompressed.
+void report_codecs(size_t num_events, size_t iterations) {
+  auto packet = event_packet(num_events);
+
+  for (auto compression :
+       {CompressionType_NONE, CompressionType_LZ4, CompressionType_LZ4_HIGH,
+        CompressionType_ZSTD, CompressionType_ZSTD_HIGH}) {
+    auto compressed = compress(packet, compression);
+    AEDAT4::Decompressor decompressor;
+    decompressor.compression = compression;
+
+    size_t size = 0;
+    int64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      auto data =
+          decompressor.decompress(compressed.data(), compressed.size(), size);
+      for (auto event : *GetSizePrefixedEventPacket(data)->elements()) {
+        checksum += event->t();
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout << "aedat4 " << EnumNameCompressionType(compression) << ": ratio "
+              << static_cast<double>(packet.size()) / compressed.size() << ", "
+              << size * iterations / seconds / 1e6 << " MB/s, "
+              << (checksum ? num_events * iterations / seconds / 1e6 : 0)
+              << " Mev/s" << std::endl;
+  }
+}
+
+// Compares decoding an event packet through the flatbuffers accessors into
+// polarity events with the column decoder.
+void report_event_decode(size_t num_events, size_t iterations) {
+  auto packet = event_packet(num_events);
+  auto elements = GetSizePrefixedEventPacket(packet.data())->elements();
+  auto events = reinterpret_cast<const Event *>(elements->Data());
+
+  std::vector<int64_t> t(num_events);
+  std::vector<int16_t> x(num_events);
+  std::vector<int16_t> y(num_events);
+  std::vector<uint8_t> p(num_events);
+
+  auto measure = [&](const std::string &name, auto &&decode) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      decode();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "event decode " << name << ": "
+              << num_events * iterations / seconds / 1e6 << " Mev/s"
+              << std::endl;
+  };
+
+  measure("polarity events", [&] {
+    std::vector<AEDAT::PolarityEvent> polarity_events;
+    polarity_events.reserve(num_events);
+    for (auto event : *elements) {
+      polarity_events.push_back(
+          AEDAT::PolarityEvent{1, static_cast<uint32_t>(event->on()),
+                               static_cast<uint32_t>(event->x()),
+                               static_cast<uint32_t>(event->y()),
+                               static_cast<uint32_t>(event->t())});
+    }
+  });
+  measure("columns scalar", [&] {
+    event_decode::decode_scalar(events, num_events, t.data(), x.data(),
+                                y.data(), p.data());
+  });
+  measure("columns simd", [&] {
+    event_decode::decode(events, num_events, t.data(), x.data(), y.data(),
+                         p.data());
+  });
+}
+
+template <typename F> void report(const std::string &name, F &&load) {
+  auto start = std::chrono::steady_clock::now();
+  size_t num_events = load();
+  auto end = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(end - start).count();
+
+  std::cout << name << ": " << num_events << " events in " << seconds
+            << " s (" << num_events / seconds / 1e6 << " Mev/s)" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  std::string filename = argc > 1 ? argv[1] : "benchmark.aedat";
+  size_t num_packets = argc > 2 ? std::stoul(argv[2]) : 2000;
+
+  write_aedat31(filename, num_packets, 4096);
+
+  report("aedat3.1 per-event", [&] { return load_per_event(filename); });
+  report("aedat3.1 bulk", [&] {
+    AEDAT data(filename);
+    return data.events.size();
+  });
+  report("aedat3.1 mapped", [&] {
+    MappedAEDAT data(filename);
+    MappedAEDAT::Packet packet;
+    size_t num_events = 0;
+    int64_t checksum = 0;
+    while (data.next(packet)) {
+      for (auto &event : packet.polarity_events()) {
+        checksum += packet.timestamp(event);
+      }
+      num_events += packet.polarity_events().size();
+    }
+    return checksum ? num_events : 0;
+  });
+
+  std::remove(filename.c_str());
+
+  report_codecs(1000000, 20);
+  report_event_decode(1000000, 50);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Queue between pipeline threads holding at most capacity items. push blocks
+// while the queue is full, which holds back a producer that runs ahead of
+// its consumers and keeps the memory of the pipeline bounded.
+template <typename T> struct BoundedQueue {
+  explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+  // Blocks until there is room for value. Returns false, dropping value, if
+  // the queue has been closed.
+  bool push(T value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+    if (closed) {
+      return false;
+    }
+    items.push_back(std::move(value));
+    not_empty.notify_one();
+    return true;
+  }
+
+  // Blocks until an item is available. Returns false once the queue is
+  // closed and empty.
+  bool pop(T &value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    not_empty.wait(lock, [this] { return closed || !items.empty(); });
+    if (items.empty()) {
+      return false;
+    }
+    value = std::move(items.front());
+    items.pop_front();
+    not_full.notify_one();
+    return true;
+  }
+
+  // Wakes up all waiting threads. Items already queued can still be popped.
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    not_full.notify_all();
+    not_empty.notify_all();
+  }
+
+private:
+  size_t capacity;
+  bool closed = false;
+  std::deque<T> items;
+  std::mutex mutex;
+  std::condition_variable not_full;
+  std::condition_variable not_empty;
+};
@@ -1,206 +1,485 @@
 #include "convert.hpp"
+#include "aedat4_writer.hpp"
 #include "dvs_gesture.hpp"
+#include "event_frames.hpp"
+#include "sliding_window.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <future>
+#include <memory>
+#include <stdexcept>
 #include <torch/csrc/autograd/python_variable.h>
 #include <torch/extension.h>
 #include <torch/script.h>
 #include <torch/torch.h>
 #include <type_traits>
+#include <unordered_map>
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 namespace py = pybind11;
 
-torch::Tensor
-convert_polarity_events(std::vector<AEDAT::PolarityEvent> &polarity_events,
-                        const std::vector<int64_t> &tensor_size)
+void check_dimensions(const std::vector<double> &scale,
+                      const std::vector<int64_t> &image_dimensions)
 {
-  const size_t size = polarity_events.size();
-  std::vector<int64_t> indices(3 * size);
-  std::vector<int8_t> values;
-  const auto max_duration =
-      tensor_size.empty()
-          ? polarity_events.back().timestamp - polarity_events[0].timestamp
-          : tensor_size[0];
+  if (scale.size() < 3 || image_dimensions.size() < 2)
+  {
+    throw std::invalid_argument(
+        "Expected 3 scale factors and 2 image dimensions");
+  }
+}
 
-  for (size_t idx = 0; idx < size; idx++)
+// Writes the sparse indices t, x, y and values p of the events [begin, end).
+// Times are taken relative to origin and coordinates are divided by scale,
+// if given.
+void fill_polarity_indices(const EventStore &events, size_t begin,
+                           size_t end, int64_t origin,
+                           const std::vector<double> &scale, int64_t *t,
+                           int64_t *x, int64_t *y, int8_t *p)
+{
+  const size_t size = end - begin;
+  for (size_t i = 0; i < size; i++)
   {
-    auto event = polarity_events[idx];
-    auto event_time = event.timestamp - polarity_events[0].timestamp;
-    //  Break if event is after max_duration
-    if (event_time >= max_duration)
+    const size_t idx = begin + i;
+    if (scale.empty())
     {
-      break;
+      t[i] = events.t[idx] - origin;
+      x[i] = events.x[idx];
+      y[i] = events.y[idx];
     }
-
-    indices[idx] = event_time;
-    indices[size + idx] = event.x;
-    indices[2 * size + idx] = event.y;
-    values.push_back(event.polarity ? 1 : -1);
+    else
+    {
+      t[i] = static_cast<int64_t>((events.t[idx] - origin) / scale[0]);
+      x[i] = static_cast<int64_t>(events.x[idx] / scale[1]);
+      y[i] = static_cast<int64_t>(events.y[idx] / scale[2]);
+    }
+    p[i] = events.p[idx] ? 1 : -1;
   }
+}
 
-  auto index_options = torch::TensorOptions().dtype(torch::kInt64);
-  torch::Tensor ind = torch::from_blob(
-      indices.data(), {3, static_cast<uint32_t>(size)}, index_options);
+// Builds a sparse tensor of the events [begin, end) directly into
+// preallocated index and value storage.
+torch::Tensor sparse_polarity_tensor(const EventStore &events, size_t begin,
+                                     size_t end, int64_t origin,
+                                     const std::vector<double> &scale,
+                                     const std::vector<int64_t> &tensor_size)
+{
+  const int64_t size = end - begin;
+  torch::Tensor ind = torch::empty({3, size}, torch::kInt64);
+  torch::Tensor val = torch::empty({size}, torch::kInt8);
+
+  auto t = ind.data_ptr<int64_t>();
+  fill_polarity_indices(events, begin, end, origin, scale, t, t + size,
+                        t + 2 * size, val.data_ptr<int8_t>());
+
+  return tensor_size.empty()
+             ? torch::sparse_coo_tensor(ind, val)
+             : torch::sparse_coo_tensor(ind, val,
+                                        torch::IntArrayRef(tensor_size));
+}
 
-  auto value_options = torch::TensorOptions().dtype(torch::kInt8);
-  torch::Tensor val = torch::from_blob(
-      values.data(), {static_cast<uint32_t>(size)}, value_options);
+torch::Tensor
+convert_polarity_events(const EventSlice &events,
+                        const std::vector<int64_t> &tensor_size)
+{
+  if (events.empty())
+  {
+    return sparse_polarity_tensor(*events.events, 0, 0, 0, {}, tensor_size);
+  }
 
-  auto events =
+  //  Only keep the events before max_duration
+  const auto t = events.t();
+  const auto max_duration =
       tensor_size.empty()
-          ? torch::sparse_coo_tensor(ind, val)
-          : torch::sparse_coo_tensor(ind, val, torch::IntArrayRef(tensor_size));
+          ? t[t.size() - 1] - t[0]
+          : tensor_size[0];
+  const size_t end =
+      std::lower_bound(t.begin(), t.end(), t[0] + max_duration) - t.begin();
 
-  return events.clone();
+  return sparse_polarity_tensor(*events.events, events.begin,
+                                events.begin + end, t[0], {}, tensor_size);
+}
+
+torch::Tensor
+convert_polarity_events(EventStore &events,
+                        const std::vector<int64_t> &tensor_size)
+{
+  return convert_polarity_events(EventSlice{&events, 0, events.size()},
+                                 tensor_size);
 }
 
 std::vector<torch::Tensor>
-convert_polarity(std::vector<AEDAT::PolarityEvent> &polarity_events,
+convert_polarity(EventStore &events,
                  const int64_t window_size,
                  const int64_t window_step,
                  const std::vector<double> &scale,
                  const std::vector<int64_t> &image_dimensions)
 {
+  check_dimensions(scale, image_dimensions);
+  const std::vector<int64_t> tensor_size = {
+      window_size, image_dimensions[0], image_dimensions[1]};
+
   std::vector<torch::Tensor> event_tensors;
-  size_t start = 0;
-  size_t idx = 0;
-  size_t next_idx = 0;
-  bool next_idx_found = false;
-  auto last_event = polarity_events.back();
-  while (start < last_event.timestamp - window_size)
+  auto windows = sliding_windows(events.t, window_size, window_step);
+  event_tensors.reserve(windows.size());
+  for (const auto &window : windows)
   {
-    auto event = polarity_events[idx];
-    size_t start_time = event.timestamp;
-    std::vector<int64_t> indices;
-    std::vector<int8_t> values;
-
-    while (event.timestamp < start + window_size)
-    {
-      indices.push_back(static_cast<int64_t>((event.timestamp - start_time) / scale[0]));
-      indices.push_back(static_cast<int64_t>(event.x / scale[1]));
-      indices.push_back(static_cast<int64_t>(event.y / scale[2]));
-      values.push_back(event.polarity ? 1 : -1);
-      if (!next_idx_found && (event.timestamp >= start + window_step))
-      {
-        next_idx = idx;
-        next_idx_found = true;
-      }
-      idx += 1;
-      event = polarity_events[idx];
-    }
+    event_tensors.push_back(sparse_polarity_tensor(
+        events, window.begin, window.end, window.start, scale, tensor_size));
+  }
 
-    // create sparse tensor
-    auto index_options = torch::TensorOptions().dtype(torch::kInt64);
-    torch::Tensor ind = torch::from_blob(
-                            indices.data(), {static_cast<uint32_t>(indices.size() / 3), 3}, index_options)
-                            .permute({1, 0});
+  return event_tensors;
+}
 
-    auto value_options = torch::TensorOptions().dtype(torch::kInt8);
-    torch::Tensor val = torch::from_blob(
-        values.data(), {static_cast<uint32_t>(indices.size() / 3)}, value_options);
-    auto events = torch::sparse_coo_tensor(ind, val, {window_size, image_dimensions[0], image_dimensions[1]});
+// The dense builders use the x and y factors of scale; time is either
+// binned (voxel grid) or decayed (time surface) instead of scaled.
+event_frames::Grid make_grid(const std::vector<double> &scale,
+                             const std::vector<int64_t> &image_dimensions)
+{
+  check_dimensions(scale, image_dimensions);
+  return event_frames::Grid{image_dimensions[0], image_dimensions[1],
+                            scale[1], scale[2]};
+}
 
-    event_tensors.push_back(events.clone());
+torch::Tensor events_to_histogram(EventStore &events,
+                                  const std::vector<double> &scale,
+                                  const std::vector<int64_t> &image_dimensions)
+{
+  auto grid = make_grid(scale, image_dimensions);
+  torch::Tensor histogram =
+      torch::zeros({2, grid.width, grid.height}, torch::kFloat32);
+  event_frames::histogram(events, 0, events.size(), grid,
+                          histogram.data_ptr<float>());
+  return histogram;
+}
 
-    idx = next_idx;
-    start += window_step;
-    next_idx_found = false;
+torch::Tensor events_to_voxel_grid(EventStore &events, const int64_t num_bins,
+                                   const std::vector<double> &scale,
+                                   const std::vector<int64_t> &image_dimensions)
+{
+  if (num_bins <= 0)
+  {
+    throw std::invalid_argument("Expected a positive number of bins");
   }
 
-  return event_tensors;
+  auto grid = make_grid(scale, image_dimensions);
+  torch::Tensor voxels =
+      torch::zeros({num_bins, grid.width, grid.height}, torch::kFloat32);
+  event_frames::voxel_grid(events, 0, events.size(), num_bins, grid,
+                           voxels.data_ptr<float>());
+  return voxels;
 }
 
-long int get_total_seconds_of_events(std::vector<AEDAT::PolarityEvent> &events)
+torch::Tensor
+events_to_time_surface(EventStore &events, const double tau,
+                       const std::vector<double> &scale,
+                       const std::vector<int64_t> &image_dimensions)
 {
-  uint32_t start = events.front().timestamp;
-  uint32_t end = events.back().timestamp;
-  auto diff = std::chrono::duration<uint32_t, std::micro>(end - start);
-  auto diff_sec = std::chrono::duration_cast<std::chrono::seconds>(diff);
+  if (tau <= 0)
+  {
+    throw std::invalid_argument("Expected a positive decay constant");
+  }
 
-  return diff_sec.count();
+  auto grid = make_grid(scale, image_dimensions);
+  torch::Tensor surface =
+      torch::zeros({2, grid.width, grid.height}, torch::kFloat32);
+  event_frames::time_surface(events, 0, events.size(), tau, grid,
+                             surface.data_ptr<float>());
+  return surface;
 }
 
-std::vector<AEDAT::PolarityEvent> get_events_at_second(std::vector<AEDAT::PolarityEvent> &events, int second)
+// Number of live guards from export_guard per store. Reloading a store
+// reallocates its columns, so readers refuse to reload while views of them
+// exist. Only accessed while holding the GIL.
+std::unordered_map<const void *, size_t> &exported_stores()
 {
-  int start_offset = 0;
+  static std::unordered_map<const void *, size_t> stores;
+  return stores;
+}
+
+// Returns an object to pass as the owner of views of the columns of store.
+// It keeps owner alive and marks store as exported until it is released.
+py::object export_guard(const void *store, py::handle owner)
+{
+  struct Guard
+  {
+    const void *store;
+    py::object owner;
+  };
 
-  auto sec = std::chrono::seconds(second);
-  auto micro_sec = std::chrono::duration_cast<std::chrono::microseconds>(sec);
+  exported_stores()[store]++;
+  return py::capsule(
+      new Guard{store, py::reinterpret_borrow<py::object>(owner)},
+      [](void *pointer)
+      {
+        auto guard = static_cast<Guard *>(pointer);
+        auto exported = exported_stores().find(guard->store);
+        if (--exported->second == 0)
+        {
+          exported_stores().erase(exported);
+        }
+        delete guard;
+      });
+}
 
-  while (events[start_offset].timestamp < micro_sec.count())
+// Throws if NumPy arrays or tensors view the columns of store.
+void check_not_exported(const void *store)
+{
+  if (exported_stores().count(store) > 0)
   {
-    start_offset += 1;
+    throw std::runtime_error("Cannot reload while NumPy arrays or tensors "
+                             "view the loaded columns");
   }
+}
+
+// Wraps a column in a NumPy array sharing its memory. The array holds a
+// reference to owner, which keeps the column alive; owners of std::vector
+// columns come from export_guard. Arrays viewing shared read-only columns
+// are not writeable.
+template <typename T>
+py::array_t<T> column_array(std::vector<T> &column, py::handle owner)
+{
+  return py::array_t<T>(column.size(), column.data(), owner);
+}
+
+template <typename T>
+py::array_t<T> column_array(const Span<T> &column, py::handle owner)
+{
+  py::array_t<T> array(column.size(), column.data, owner);
+  array.attr("setflags")(false);
+  return array;
+}
 
-  std::vector<AEDAT::PolarityEvent> events_in_interval(events.begin(), events.begin() + start_offset);
+// Returns a property getter viewing a column of the bound object as a NumPy
+// array. The array can modify the values but not the length of the column.
+template <typename Store, typename T>
+auto column_property(std::vector<T> Store::*column)
+{
+  return [column](py::object self)
+  {
+    auto &store = self.cast<Store &>();
+    return column_array(store.*column, export_guard(&store, self));
+  };
+}
 
-  return events_in_interval;
+// Wraps a column in a tensor sharing its memory. The tensor holds a
+// reference to owner until its storage is released.
+template <typename T>
+torch::Tensor column_tensor(std::vector<T> &column, py::handle owner,
+                            torch::Dtype dtype)
+{
+  owner.inc_ref();
+  return torch::from_blob(
+      column.data(), {static_cast<int64_t>(column.size())},
+      [owner](void *) mutable
+      {
+        py::gil_scoped_acquire gil;
+        owner.dec_ref();
+      },
+      torch::TensorOptions().dtype(dtype));
 }
 
-std::vector<std::vector<AEDAT::PolarityEvent>> split_events(std::vector<AEDAT::PolarityEvent> &events)
+// Wraps a column of a copy-on-write mapping, which can be written to even
+// though the view is const, see EventCache::open.
+template <typename T>
+torch::Tensor column_tensor(const Span<T> &column, py::handle owner,
+                            torch::Dtype dtype)
 {
-  std::vector<std::vector<AEDAT::PolarityEvent>> split_events;
+  owner.inc_ref();
+  return torch::from_blob(
+      const_cast<T *>(column.data), {static_cast<int64_t>(column.size())},
+      [owner](void *) mutable
+      {
+        py::gil_scoped_acquire gil;
+        owner.dec_ref();
+      },
+      torch::TensorOptions().dtype(dtype));
+}
 
-  int start_offset = 0;
-  int end_offset = 0;
-  int cur_sec = 0;
+// Returns the columns of events as NumPy arrays viewing the memory of
+// owner, which must own events. The owner cannot reload the events while
+// the views exist.
+py::dict events_numpy(EventStore &events, py::handle owner)
+{
+  auto guard = export_guard(&events, owner);
+  py::dict columns;
+  columns["t"] = column_array(events.t, guard);
+  columns["x"] = column_array(events.x, guard);
+  columns["y"] = column_array(events.y, guard);
+  columns["p"] = column_array(events.p, guard);
+  return columns;
+}
 
-  auto total_seconds = get_total_seconds_of_events(events);
+// Returns the columns of events as tensors, see events_numpy.
+py::dict events_torch(EventStore &events, py::handle owner)
+{
+  auto guard = export_guard(&events, owner);
+  py::dict columns;
+  columns["t"] = column_tensor(events.t, guard, torch::kInt64);
+  columns["x"] = column_tensor(events.x, guard, torch::kInt16);
+  columns["y"] = column_tensor(events.y, guard, torch::kInt16);
+  columns["p"] = column_tensor(events.p, guard, torch::kUInt8);
+  return columns;
+}
 
-  while (cur_sec <= total_seconds)
+// Returns the columns of IMU samples as NumPy arrays viewing the memory of
+// owner, see events_numpy.
+py::dict imus_numpy(ImuStore &imus, py::handle owner)
+{
+  auto guard = export_guard(&imus, owner);
+  py::dict columns;
+  columns["t"] = column_array(imus.t, guard);
+  for (size_t idx = 0; idx < ImuStore::num_float_columns; idx++)
   {
+    columns[ImuStore::float_column_name(idx)] =
+        column_array(*imus.float_column(idx), guard);
+  }
+  return columns;
+}
 
-    auto sec = std::chrono::seconds(cur_sec);
-    auto micro_sec = std::chrono::duration_cast<std::chrono::microseconds>(sec);
+py::dict imus_torch(ImuStore &imus, py::handle owner)
+{
+  auto guard = export_guard(&imus, owner);
+  py::dict columns;
+  columns["t"] = column_tensor(imus.t, guard, torch::kInt64);
+  for (size_t idx = 0; idx < ImuStore::num_float_columns; idx++)
+  {
+    columns[ImuStore::float_column_name(idx)] =
+        column_tensor(*imus.float_column(idx), guard, torch::kFloat32);
+  }
+  return columns;
+}
 
-    do
-    {
-      end_offset += 1;
-    } while (events[end_offset].timestamp < micro_sec.count());
+torch::Tensor
+convert_polarity_batched(EventStore &events,
+                         const int64_t window_size,
+                         const int64_t window_step,
+                         const std::vector<double> &scale,
+                         const std::vector<int64_t> &image_dimensions)
+{
+  check_dimensions(scale, image_dimensions);
+  auto windows = sliding_windows(events.t, window_size, window_step);
+  const int64_t num_windows = windows.size();
 
-    auto temp_vec = std::vector<AEDAT::PolarityEvent>(events.begin() + start_offset, events.begin() + end_offset);
-    split_events.push_back(temp_vec);
+  // events of window i start at offsets[i] in the shared index buffer
+  std::vector<int64_t> offsets(num_windows + 1, 0);
+  for (int64_t i = 0; i < num_windows; i++)
+  {
+    offsets[i + 1] = offsets[i] + windows[i].size();
+  }
+  const int64_t size = offsets.back();
+
+  torch::Tensor ind = torch::empty({4, size}, torch::kInt64);
+  torch::Tensor val = torch::empty({size}, torch::kInt8);
+  auto w = ind.data_ptr<int64_t>();
+  auto t = w + size;
+  auto x = t + size;
+  auto y = x + size;
+  auto p = val.data_ptr<int8_t>();
 
-    start_offset = end_offset;
-    cur_sec += 1;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+  for (int64_t i = 0; i < num_windows; i++)
+  {
+    const auto &window = windows[i];
+    const int64_t offset = offsets[i];
+    std::fill(w + offset, w + offsets[i + 1], i);
+    fill_polarity_indices(events, window.begin, window.end, window.start,
+                          scale, t + offset, x + offset, y + offset,
+                          p + offset);
   }
 
-  return split_events;
+  return torch::sparse_coo_tensor(
+      ind, val,
+      {num_windows, window_size, image_dimensions[0], image_dimensions[1]});
 }
 
-std::vector<torch::Tensor> get_frames_from_events(std::vector<AEDAT::PolarityEvent> &events)
+long int get_total_seconds_of_events(EventStore &events)
 {
+  if (events.empty())
+  {
+    return 0;
+  }
 
-  std::vector<torch::Tensor> frames;
+  int64_t start = events.t.front();
+  int64_t end = events.t.back();
+  auto diff = std::chrono::duration<int64_t, std::micro>(end - start);
+  auto diff_sec = std::chrono::duration_cast<std::chrono::seconds>(diff);
 
-  int start_offset = 0;
-  int end_offset = 0;
-  int cur_sec = 0;
+  return diff_sec.count();
+}
 
-  auto total_seconds = get_total_seconds_of_events(events);
+// Returns the range of events in the given second of the recording, counted
+// from its first event.
+std::pair<size_t, size_t> second_range(const EventStore &events,
+                                       int64_t second)
+{
+  if (events.empty())
+  {
+    return {0, 0};
+  }
+
+  const int64_t micro_sec =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::seconds(1))
+          .count();
+  const int64_t start = events.t.front() + second * micro_sec;
+  return events.range(start, start + micro_sec);
+}
+
+EventSlice get_events_between(EventStore &events, int64_t start, int64_t end)
+{
+  auto range = events.range(start, end);
+  return EventSlice{&events, range.first, range.second};
+}
+
+// Returns the events before the given second, in absolute time.
+EventSlice get_events_at_second(EventStore &events, int second)
+{
+  const int64_t micro_sec =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::seconds(second))
+          .count();
+  return EventSlice{&events, 0, events.lower_bound(micro_sec)};
+}
+
+EventSlice get_events_in_second(EventStore &events, int64_t second)
+{
+  auto range = second_range(events, second);
+  return EventSlice{&events, range.first, range.second};
+}
+
+std::vector<EventSlice> split_events(EventStore &events)
+{
+  std::vector<EventSlice> split_events;
 
-  while (cur_sec <= total_seconds)
+  auto total_seconds = get_total_seconds_of_events(events);
+  for (int64_t cur_sec = 0; !events.empty() && cur_sec <= total_seconds;
+       cur_sec++)
   {
-    auto sec = std::chrono::seconds(cur_sec);
-    auto micro_sec = std::chrono::duration_cast<std::chrono::microseconds>(sec);
+    auto range = second_range(events, cur_sec);
+    split_events.push_back(EventSlice{&events, range.first, range.second});
+  }
 
-    do
-    {
-      end_offset += 1;
-    } while (events[end_offset].timestamp < micro_sec.count());
+  return split_events;
+}
 
-    auto temp_vec = std::vector<AEDAT::PolarityEvent>(events.begin() + start_offset, events.begin() + end_offset);
+std::vector<torch::Tensor> get_frames_from_events(EventStore &events)
+{
+
+  std::vector<torch::Tensor> frames;
 
-    torch::Tensor tensors = convert_polarity_events(temp_vec);
+  for (const auto &slice : split_events(events))
+  {
+    torch::Tensor tensors = convert_polarity_events(slice);
     //torch::Tensor aggr_tensor = torch::_sparse_sum(tensors, 0);
 
     //frames.push_back(aggr_tensor);
-
-    start_offset = end_offset;
-    cur_sec += 1;
   }
 
   std::reverse(frames.begin(), frames.end());
@@ -208,25 +487,396 @@ std::vector<torch::Tensor> get_frames_from_events(std::vector<AEDAT::PolarityEve
   return frames;
 }
 
+// Slices returned to Python as a sequence. Every slice handed out keeps the
+// sequence alive, which keeps the sliced events alive.
+struct EventSlices
+{
+  std::vector<EventSlice> slices;
+
+  size_t size() const { return slices.size(); }
+
+  EventSlice get(int64_t idx) const
+  {
+    if (idx < 0)
+    {
+      idx += static_cast<int64_t>(slices.size());
+    }
+    if (idx < 0 || static_cast<size_t>(idx) >= slices.size())
+    {
+      throw py::index_error("slice index out of range");
+    }
+    return slices[idx];
+  }
+};
+
+// Throws if NumPy arrays or tensors view the stores a reload of reader
+// would reallocate.
+void check_reloadable(const AEDAT &reader)
+{
+  check_not_exported(&reader.events);
+}
+
+void check_reloadable(const AEDAT4 &reader)
+{
+  check_not_exported(&reader.events);
+  check_not_exported(&reader.imus);
+  check_not_exported(&reader.triggers);
+}
+
+// Data points own their events, so reloading a data set is always safe.
+void check_reloadable(const dvs_gesture::DataSet &) {}
+
+// Returns a binding of the member function load of a reader that reloads
+// only if check_reloadable passes, releasing the GIL while loading.
+template <typename T, typename... Args>
+auto checked_reload(void (T::*load)(Args...))
+{
+  return [load](T &reader, Args... args)
+  {
+    check_reloadable(reader);
+    py::gil_scoped_release release;
+    (reader.*load)(args...);
+  };
+}
+
+// A load running on a background thread. It references the reader being
+// loaded, which must not be used from Python until the load is done.
+struct LoadFuture
+{
+  py::object owner;
+  std::shared_future<void> future;
+
+  bool done() const
+  {
+    return future.wait_for(std::chrono::seconds(0)) ==
+           std::future_status::ready;
+  }
+
+  // Waits for the load to finish and returns the reader, rethrowing any
+  // exception raised while loading.
+  py::object result() const
+  {
+    {
+      py::gil_scoped_release release;
+      future.wait();
+    }
+    future.get();
+    return owner;
+  }
+};
+
+// Starts self.load(args...) on a new thread.
+template <typename T, typename... Args>
+LoadFuture load_async(py::object self, Args... args)
+{
+  T &reader = self.cast<T &>();
+  check_reloadable(reader);
+  return LoadFuture{
+      self,
+      std::async(std::launch::async, [&reader, args...]
+                 { reader.load(args...); })
+          .share()};
+}
+
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m)
 {
-  py::class_<AEDAT::PolarityEvent>(m, "PolarityEvent")
-      .def("get_valid", &AEDAT::PolarityEvent::get_valid)
-      .def("get_x", &AEDAT::PolarityEvent::get_x)
-      .def("get_y", &AEDAT::PolarityEvent::get_y)
-      .def("get_polarity", &AEDAT::PolarityEvent::get_polarity)
-      .def("get_timestamp", &AEDAT::PolarityEvent::get_timestamp);
+  using release_gil = py::call_guard<py::gil_scoped_release>;
+
+  py::class_<LoadFuture>(m, "LoadFuture")
+      .def("done", &LoadFuture::done,
+           "Returns whether the load has finished")
+      .def("result", &LoadFuture::result,
+           "Waits for the load to finish and returns the loaded object");
+
+  py::class_<EventStore>(m, "EventStore")
+      .def(py::init<>())
+      .def(py::init([](std::vector<int64_t> t, std::vector<int16_t> x,
+                       std::vector<int16_t> y, std::vector<uint8_t> p)
+                    {
+                      if (x.size() != t.size() || y.size() != t.size() ||
+                          p.size() != t.size())
+                      {
+                        throw std::runtime_error(
+                            "Event columns differ in length");
+                      }
+                      auto events = std::make_unique<EventStore>();
+                      events->t = std::move(t);
+                      events->x = std::move(x);
+                      events->y = std::move(y);
+                      events->p = std::move(p);
+                      events->index_time();
+                      return events;
+                    }),
+           py::arg("t"),
+           py::arg("x"),
+           py::arg("y"),
+           py::arg("p"),
+           "Copies events from columns of equal length")
+      .def("__len__", &EventStore::size)
+      .def_property_readonly("t", column_property(&EventStore::t),
+                             "Timestamps in microseconds, as a NumPy array "
+                             "sharing memory with the store")
+      .def_property_readonly("x", column_property(&EventStore::x))
+      .def_property_readonly("y", column_property(&EventStore::y))
+      .def_property_readonly("p", column_property(&EventStore::p))
+      .def("index_time", &EventStore::index_time,
+           py::arg("granularity") = TimeIndex::default_granularity,
+           release_gil(),
+           "Sorts the events by time if needed and indexes the timestamps "
+           "with one entry per granularity microseconds, or coarser if that "
+           "would take more entries than events. The loaders do this with "
+           "the default granularity")
+      .def("lower_bound", &EventStore::lower_bound,
+           py::arg("time"),
+           "Returns the offset of the first event at or after time")
+      .def("range", &EventStore::range,
+           py::arg("start"),
+           py::arg("end"),
+           "Returns the offsets (begin, end) of the events in [start, end)")
+      .def("numpy", [](py::object self)
+           { return events_numpy(self.cast<EventStore &>(), self); },
+           "Returns the columns as NumPy arrays sharing memory with the store")
+      .def("torch", [](py::object self)
+           { return events_torch(self.cast<EventStore &>(), self); },
+           "Returns the columns as tensors sharing memory with the store");
+
+  py::class_<ImuStore>(m, "ImuStore")
+      .def(py::init<>())
+      .def("__len__", &ImuStore::size)
+      .def_property_readonly("t", column_property(&ImuStore::t),
+                             "Timestamps in microseconds, as a NumPy array "
+                             "sharing memory with the store")
+      .def("index_time", &ImuStore::index_time,
+           py::arg("granularity") = TimeIndex::default_granularity,
+           release_gil(),
+           "Sorts the samples by time if needed and indexes them")
+      .def("lower_bound", &ImuStore::lower_bound,
+           py::arg("time"),
+           "Returns the offset of the first sample at or after time")
+      .def("range", &ImuStore::range,
+           py::arg("start"),
+           py::arg("end"),
+           "Returns the offsets (begin, end) of the samples in [start, end)")
+      .def("slice", &ImuStore::slice,
+           py::arg("begin"),
+           py::arg("end"),
+           "Returns a copy of the samples [begin, end)")
+      .def("numpy", [](py::object self)
+           { return imus_numpy(self.cast<ImuStore &>(), self); },
+           "Returns t, accelerometer_x/y/z, gyroscope_x/y/z, "
+           "magnetometer_x/y/z and temperature as NumPy arrays sharing "
+           "memory with the store")
+      .def("torch", [](py::object self)
+           { return imus_torch(self.cast<ImuStore &>(), self); },
+           "Returns the columns as tensors sharing memory with the store");
+
+  py::class_<TriggerStore>(m, "TriggerStore")
+      .def(py::init<>())
+      .def("__len__", &TriggerStore::size)
+      .def_property_readonly("t", column_property(&TriggerStore::t),
+                             "Timestamps in microseconds, as a NumPy array "
+                             "sharing memory with the store")
+      .def_property_readonly("source", column_property(&TriggerStore::source),
+                             "TriggerSource values, as a NumPy array "
+                             "sharing memory with the store")
+      .def("index", &TriggerStore::index,
+           "Sorts the triggers and indexes them by source. The loaders do "
+           "this")
+      .def("count",
+           [](const TriggerStore &self, const std::string &source)
+           { return self.count(TriggerStore::to_source(source)); },
+           py::arg("source"),
+           "Returns the number of triggers of a source, such as "
+           "'ExternalSignalRisingEdge' or 'FrameBegin'")
+      .def("time",
+           [](const TriggerStore &self, const std::string &source, size_t k)
+           { return self.time(TriggerStore::to_source(source), k); },
+           py::arg("source"),
+           py::arg("k"),
+           "Returns the time of the k-th trigger of a source")
+      .def("interval",
+           [](const TriggerStore &self, const std::string &source,
+              int64_t time)
+           { return self.interval(TriggerStore::to_source(source), time); },
+           py::arg("source"),
+           py::arg("time"),
+           "Returns the index of the last trigger of a source at or before "
+           "time, or -1")
+      .def("events_between",
+           [](const TriggerStore &self, const EventStore &events,
+              const std::string &source, size_t k)
+           {
+             return self.events_between(events, TriggerStore::to_source(source),
+                                        k);
+           },
+           py::arg("events"),
+           py::arg("source"),
+           py::arg("k"),
+           "Returns the offsets (begin, end) of the events from the k-th "
+           "trigger of a source to the next one")
+      .def("all_events_between",
+           [](const TriggerStore &self, const EventStore &events,
+              const std::string &source)
+           {
+             return self.events_between(events,
+                                        TriggerStore::to_source(source));
+           },
+           py::arg("events"),
+           py::arg("source"),
+           release_gil(),
+           "Returns the event offsets between all consecutive triggers of a "
+           "source");
+
+  py::class_<EventSlice>(m, "EventSlice")
+      .def_readonly("begin", &EventSlice::begin)
+      .def_readonly("end", &EventSlice::end)
+      .def("__len__", &EventSlice::size)
+      .def("copy", &EventSlice::copy,
+           "Returns a copy of the viewed events as an EventStore")
+      .def("numpy", [](py::object self)
+           {
+             auto &slice = self.cast<EventSlice &>();
+             auto guard = export_guard(slice.events, self);
+             py::dict columns;
+             columns["t"] = column_array(slice.t(), guard);
+             columns["x"] = column_array(slice.x(), guard);
+             columns["y"] = column_array(slice.y(), guard);
+             columns["p"] = column_array(slice.p(), guard);
+             return columns;
+           },
+           "Returns the columns t, x, y and p of the viewed events as "
+           "read-only NumPy arrays without copying");
+
+  py::class_<EventSlices>(m, "EventSlices")
+      .def("__len__", &EventSlices::size)
+      .def("__getitem__", &EventSlices::get, py::keep_alive<0, 1>());
+
+  py::class_<Annotations::Annotation>(m, "Annotation")
+      .def_readonly("label", &Annotations::Annotation::label)
+      .def_readonly("start_time", &Annotations::Annotation::start_time)
+      .def_readonly("end_time", &Annotations::Annotation::end_time);
+
+  py::class_<Annotations::Segment>(m, "AnnotationSegment")
+      .def_readonly("label", &Annotations::Segment::label)
+      .def_readonly("start_time", &Annotations::Segment::start_time)
+      .def_readonly("begin", &Annotations::Segment::begin)
+      .def_readonly("end", &Annotations::Segment::end);
+
+  py::class_<Annotations>(m, "Annotations")
+      .def(py::init<>())
+      .def(py::init<const std::string &>(), py::arg("filename"))
+      .def("read_csv", &Annotations::read_csv,
+           py::arg("filename"),
+           "Reads label,start,end rows, raising on malformed, unordered or "
+           "overlapping rows")
+      .def("__len__", &Annotations::size)
+      .def("segments",
+           py::overload_cast<const EventStore &>(&Annotations::segments,
+                                                 py::const_),
+           py::arg("events"),
+           "Returns the ranges of events covered by the annotations")
+      .def_readonly("annotations", &Annotations::annotations);
 
   py::class_<dvs_gesture::DataSet::DataPoint>(m, "DVSGestureDataPoint")
       .def_readonly("label", &dvs_gesture::DataSet::DataPoint::label)
-      .def_readonly("events", &dvs_gesture::DataSet::DataPoint::events);
+      .def_readonly("start_time", &dvs_gesture::DataSet::DataPoint::start_time)
+      .def("__len__", &dvs_gesture::DataSet::DataPoint::size)
+      .def_property_readonly("events", &dvs_gesture::DataSet::DataPoint::events,
+                             "Copy of the events, with times relative to "
+                             "start_time")
+      .def("events_numpy", [](py::object self)
+           {
+             auto &datapoint = self.cast<dvs_gesture::DataSet::DataPoint &>();
+             py::dict columns;
+             columns["t"] = column_array(datapoint.t(), self);
+             columns["x"] = column_array(datapoint.x(), self);
+             columns["y"] = column_array(datapoint.y(), self);
+             columns["p"] = column_array(datapoint.p(), self);
+             return columns;
+           },
+           "Returns the event columns t, x, y and p as read-only NumPy arrays "
+           "sharing memory with the recording. Times are not shifted by "
+           "start_time");
 
   py::class_<dvs_gesture::DataSet>(m, "DVSGestureData")
       .def(py::init<>())
-      .def(py::init<const std::string &, const std::string &>())
-      .def("load", &dvs_gesture::DataSet::load)
+      .def(py::init<const std::string &, const std::string &>(), release_gil())
+      .def("load", &dvs_gesture::DataSet::load, release_gil())
+      .def("load_directory", &dvs_gesture::DataSet::load_directory,
+           py::arg("directory"),
+           py::arg("cache_filename") = "",
+           py::arg("num_threads") = 0,
+           release_gil(),
+           "Loads all recordings of a directory in parallel. If given, the "
+           "cache file is mapped when it exists and written otherwise")
+      .def("load_async",
+           &load_async<dvs_gesture::DataSet, std::string, std::string>,
+           py::arg("aedat_filename"),
+           py::arg("labels_filename"),
+           "Loads the data set on a background thread and returns a "
+           "LoadFuture")
       .def_readonly("datapoints", &dvs_gesture::DataSet::datapoints);
 
+  py::class_<EventCache::Segment>(m, "EventCacheSegment")
+      .def_readonly("label", &EventCache::Segment::label)
+      .def_readonly("start_time", &EventCache::Segment::start_time)
+      .def_readonly("begin", &EventCache::Segment::begin)
+      .def_readonly("end", &EventCache::Segment::end)
+      .def("__len__", &EventCache::Segment::size);
+
+  py::class_<EventCache>(m, "EventCache")
+      .def(py::init([](const std::string &filename)
+                    { return std::make_unique<EventCache>(filename, true); }),
+           py::arg("filename"),
+           "Maps a cache file. Changes to the mapped columns stay in memory")
+      .def_static("write",
+                  py::overload_cast<const std::string &, const EventStore &,
+                                    const Annotations &>(&EventCache::write),
+                  py::arg("filename"),
+                  py::arg("events"),
+                  py::arg("annotations") = Annotations(),
+                  release_gil(),
+                  "Writes events and the segments of annotations over them")
+      .def("__len__", &EventCache::num_segments)
+      .def_property_readonly("num_events", &EventCache::num_events)
+      .def_property_readonly("segments", [](const EventCache &cache)
+                             {
+                               auto segments = cache.segments();
+                               return std::vector<EventCache::Segment>(
+                                   segments.begin(), segments.end());
+                             })
+      .def("lower_bound", &EventCache::lower_bound,
+           py::arg("time"),
+           "Returns the offset of the first event at or after time")
+      .def("range", &EventCache::range,
+           py::arg("start"),
+           py::arg("end"),
+           "Returns the offsets (begin, end) of the events in [start, end)")
+      .def("torch", [](py::object self)
+           {
+             auto &cache = self.cast<EventCache &>();
+             py::dict columns;
+             columns["t"] = column_tensor(cache.t(), self, torch::kInt64);
+             columns["x"] = column_tensor(cache.x(), self, torch::kInt16);
+             columns["y"] = column_tensor(cache.y(), self, torch::kInt16);
+             columns["p"] = column_tensor(cache.p(), self, torch::kUInt8);
+             return columns;
+           },
+           "Returns the columns t, x, y and p as tensors viewing the mapped "
+           "file. Slice them with the segments or range")
+      .def("numpy", [](py::object self)
+           {
+             auto &cache = self.cast<EventCache &>();
+             py::dict columns;
+             columns["t"] = column_array(cache.t(), self);
+             columns["x"] = column_array(cache.x(), self);
+             columns["y"] = column_array(cache.y(), self);
+             columns["p"] = column_array(cache.p(), self);
+             return columns;
+           },
+           "Returns the columns t, x, y and p as read-only NumPy arrays "
+           "viewing the mapped file");
+
   py::class_<AEDAT4::Frame>(m, "AEDAT4Frame")
       .def_readwrite("time", &AEDAT4::Frame::time)
       .def_readwrite("width", &AEDAT4::Frame::width)
@@ -235,48 +885,249 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m)
 
   py::class_<AEDAT>(m, "AEDAT")
       .def(py::init<>())
-      .def(py::init<const std::string &>())
-      .def("load", &AEDAT::load)
-      .def_readwrite("polarity_events", &AEDAT::polarity_events)
+      .def(py::init<const std::string &>(), release_gil())
+      .def("load", checked_reload(&AEDAT::load))
+      .def("load_async", &load_async<AEDAT, std::string>,
+           py::arg("filename"),
+           "Loads the file on a background thread and returns a LoadFuture")
+      .def("export_cache",
+           py::overload_cast<const std::string &, const Annotations &>(
+               &AEDAT::export_cache, py::const_),
+           py::arg("filename"),
+           py::arg("annotations") = Annotations(),
+           release_gil(),
+           "Writes the polarity events to an EventCache")
+      .def_readonly("events", &AEDAT::events)
       .def_readwrite("dynapse_events", &AEDAT::dynapse_events)
       .def_readwrite("imu6_events", &AEDAT::imu6_events)
-      .def_readwrite("imu9_events", &AEDAT::imu9_events);
+      .def_readwrite("imu9_events", &AEDAT::imu9_events)
+      .def("events_numpy", [](py::object self)
+           { return events_numpy(self.cast<AEDAT &>().events, self); },
+           "Returns the polarity event columns t, x, y and p as NumPy "
+           "arrays sharing memory with this object")
+      .def("events_torch", [](py::object self)
+           { return events_torch(self.cast<AEDAT &>().events, self); },
+           "Returns the polarity event columns t, x, y and p as tensors "
+           "sharing memory with this object");
 
   m.def("convert_polarity", &convert_polarity,
-        py::arg("polarity_events"),
+        release_gil(),
+        py::arg("events"),
         py::arg("window_size"),
         py::arg("window_step"),
         py::arg("scale"),
         py::arg("image_dimension"),
         "Converts the AEDAT data into a dense Torch tensor.");
 
+  m.def("convert_polarity_batched", &convert_polarity_batched,
+        release_gil(),
+        py::arg("events"),
+        py::arg("window_size"),
+        py::arg("window_step"),
+        py::arg("scale"),
+        py::arg("image_dimension"),
+        "Converts the sliding windows of convert_polarity into a single "
+        "sparse tensor of shape (windows, window_size, *image_dimension).");
+
+  m.def("events_to_histogram", &events_to_histogram,
+        release_gil(),
+        py::arg("events"),
+        py::arg("scale"),
+        py::arg("image_dimension"),
+        "Counts the events per polarity and pixel into a dense tensor of "
+        "shape (2, width, height).");
+
+  m.def("events_to_voxel_grid", &events_to_voxel_grid,
+        release_gil(),
+        py::arg("events"),
+        py::arg("num_bins"),
+        py::arg("scale"),
+        py::arg("image_dimension"),
+        "Accumulates the event polarities into a dense tensor of shape "
+        "(num_bins, width, height), interpolating linearly between bins.");
+
+  m.def("events_to_time_surface", &events_to_time_surface,
+        release_gil(),
+        py::arg("events"),
+        py::arg("tau"),
+        py::arg("scale"),
+        py::arg("image_dimension"),
+        "Decays the time of the latest event per polarity and pixel "
+        "exponentially with tau microseconds into a dense tensor of shape "
+        "(2, width, height).");
+
   m.def("get_frames_from_events", &get_frames_from_events,
-        py::arg("polarity_events"),
+        release_gil(),
+        py::arg("events"),
         "Converts events into frame");
 
   m.def("get_total_seconds_of_events", &get_total_seconds_of_events,
-        py::arg("polarity_events"),
+        py::arg("events"),
         "Get seconds of event");
 
   m.def("get_events_at_second", &get_events_at_second,
-        py::arg("polarity_events"),
+        py::keep_alive<0, 1>(),
+        py::arg("events"),
+        py::arg("second"),
+        "Get a view of the events before the given second, in absolute "
+        "time");
+
+  m.def("get_events_in_second", &get_events_in_second,
+        py::keep_alive<0, 1>(),
+        py::arg("events"),
         py::arg("second"),
-        "Get all events in specific time intervall");
+        "Get a view of the events in the given second, counted from the "
+        "first event, as returned by split_events");
+
+  m.def("get_events_between", &get_events_between,
+        py::keep_alive<0, 1>(),
+        py::arg("events"),
+        py::arg("start"),
+        py::arg("end"),
+        "Get a view of the events in the time window [start, end)");
 
-  m.def("split_events", &split_events,
-        py::arg("polarity_events"),
-        "Splits events");
+  m.def("split_events", [](EventStore &events)
+        { return EventSlices{split_events(events)}; },
+        py::keep_alive<0, 1>(),
+        py::arg("events"),
+        "Splits events into views of one second each");
 
-  m.def("convert_polarity_events", &convert_polarity_events,
-        py::arg("polarity_events"),
+  m.def("convert_polarity_events",
+        py::overload_cast<EventStore &, const std::vector<int64_t> &>(
+            &convert_polarity_events),
+        release_gil(),
+        py::arg("events"),
         py::arg("tensor_size") = std::vector<int64_t>(),
         "Converts the AEDAT data into a sparse Torch tensor. If provided, the "
         "tensor is loaded and shaped after the tensor_size argument");
 
+  m.def("convert_polarity_events",
+        py::overload_cast<const EventSlice &, const std::vector<int64_t> &>(
+            &convert_polarity_events),
+        release_gil(),
+        py::arg("events"),
+        py::arg("tensor_size") = std::vector<int64_t>(),
+        "Converts a view of events into a sparse Torch tensor");
+
   py::class_<AEDAT4>(m, "AEDAT4")
       .def(py::init<>())
-      .def(py::init<const std::string &>())
-      .def("load", &AEDAT4::load)
-      .def_readwrite("polarity_events", &AEDAT4::polarity_events)
-      .def_readwrite("frames", &AEDAT4::frames);
+      .def(py::init<const std::string &, size_t>(),
+           py::arg("filename"),
+           py::arg("num_threads") = 1,
+           release_gil())
+      .def("load", checked_reload(&AEDAT4::load),
+           py::arg("filename"),
+           py::arg("num_threads") = 1,
+           "Loads the whole file, decoding packets on num_threads threads")
+      .def("load_async", &load_async<AEDAT4, std::string, size_t>,
+           py::arg("filename"),
+           py::arg("num_threads") = 1,
+           "Loads the file on a background thread and returns a LoadFuture")
+      .def("open", &AEDAT4::open, release_gil())
+      .def("export_cache",
+           py::overload_cast<const std::string &, const Annotations &>(
+               &AEDAT4::export_cache, py::const_),
+           py::arg("filename"),
+           py::arg("annotations") = Annotations(),
+           release_gil(),
+           "Writes the decoded events to an EventCache")
+      .def("read_range", checked_reload(&AEDAT4::read_range),
+           py::arg("start"),
+           py::arg("end"),
+           "Decodes the events, frames, IMU samples and triggers in "
+           "[start, end) only")
+      .def_readonly("events", &AEDAT4::events)
+      .def_readwrite("frames", &AEDAT4::frames)
+      .def_readonly("imus", &AEDAT4::imus)
+      .def_readonly("triggers", &AEDAT4::triggers)
+      .def("imus_numpy", [](py::object self)
+           { return imus_numpy(self.cast<AEDAT4 &>().imus, self); },
+           "Returns the IMU columns as NumPy arrays sharing memory with this "
+           "object")
+      .def("imus_torch", [](py::object self)
+           { return imus_torch(self.cast<AEDAT4 &>().imus, self); },
+           "Returns the IMU columns as tensors sharing memory with this "
+           "object")
+      .def("events_numpy", [](py::object self)
+           { return events_numpy(self.cast<AEDAT4 &>().events, self); },
+           "Returns the event columns t, x, y and p as NumPy arrays sharing "
+           "memory with this object")
+      .def("events_torch", [](py::object self)
+           { return events_torch(self.cast<AEDAT4 &>().events, self); },
+           "Returns the event columns t, x, y and p as tensors sharing "
+           "memory with this object");
+
+  py::class_<AEDAT4Writer>(m, "AEDAT4Writer")
+      .def(py::init<>())
+      .def("add_stream",
+           [](AEDAT4Writer &self, const std::string &type, int size_x,
+              int size_y)
+           { return self.add_stream(AEDAT4::OutInfo::to_type(type), size_x,
+                                    size_y); },
+           py::arg("type"),
+           py::arg("size_x") = 0,
+           py::arg("size_y") = 0,
+           "Declares an EVTS, FRME, IMUS or TRIG stream and returns its id")
+      .def("open",
+           [](AEDAT4Writer &self, const std::string &filename,
+              const std::string &compression, size_t num_threads)
+           { self.open(filename, AEDAT4Writer::to_compression(compression),
+                       num_threads); },
+           py::arg("filename"),
+           py::arg("compression") = "LZ4",
+           py::arg("num_threads") = 1,
+           "Creates the file, compressing packets on num_threads threads")
+      .def("write_events",
+           py::overload_cast<int32_t, const EventStore &>(
+               &AEDAT4Writer::write_events),
+           py::arg("stream_id"),
+           py::arg("events"),
+           release_gil())
+      .def("write_events",
+           py::overload_cast<int32_t, const EventStore &, size_t, size_t>(
+               &AEDAT4Writer::write_events),
+           py::arg("stream_id"),
+           py::arg("events"),
+           py::arg("begin"),
+           py::arg("end"),
+           release_gil())
+      .def("write_frame", &AEDAT4Writer::write_frame, release_gil())
+      .def("write_imus",
+           [](AEDAT4Writer &self, int32_t stream_id, const ImuStore &imus)
+           { self.write_imus(stream_id, imus, 0, imus.size()); },
+           py::arg("stream_id"),
+           py::arg("imus"),
+           release_gil(),
+           "Writes the IMU samples as a single packet")
+      .def("write_imus",
+           py::overload_cast<int32_t, const ImuStore &, size_t, size_t>(
+               &AEDAT4Writer::write_imus),
+           py::arg("stream_id"),
+           py::arg("imus"),
+           py::arg("begin"),
+           py::arg("end"),
+           release_gil())
+      .def("write_triggers",
+           [](AEDAT4Writer &self, int32_t stream_id,
+              const TriggerStore &triggers)
+           { self.write_triggers(stream_id, triggers, 0, triggers.size()); },
+           py::arg("stream_id"),
+           py::arg("triggers"),
+           release_gil(),
+           "Writes the triggers as a single packet")
+      .def("write_triggers",
+           py::overload_cast<int32_t, const TriggerStore &, size_t, size_t>(
+               &AEDAT4Writer::write_triggers),
+           py::arg("stream_id"),
+           py::arg("triggers"),
+           py::arg("begin"),
+           py::arg("end"),
+           release_gil())
+      .def("close", &AEDAT4Writer::close, release_gil(),
+           "Writes the data table and finishes the file")
+      .def("__enter__", [](py::object self) { return self; })
+      .def("__exit__",
+           [](AEDAT4Writer &self, py::object, py::object, py::object)
+           { self.close(); })
+      .def_readwrite("events_per_packet", &AEDAT4Writer::events_per_packet);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "aedat.hpp"
 #include "aedat4.hpp"
+#include "event_store.hpp"
 
 #include <iostream>
 #include <sys/types.h>
@@ -10,5 +11,9 @@
 #include <pybind11/stl.h>
 
 torch::Tensor convert_polarity_events(
-    std::vector<AEDAT::PolarityEvent> &polarity_events,
+    EventStore &events,
+    const std::vector<int64_t> &tensor_size = std::vector<int64_t>());
+
+torch::Tensor convert_polarity_events(
+    const EventSlice &events,
     const std::vector<int64_t> &tensor_size = std::vector<int64_t>());
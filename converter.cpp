@@ -1,15 +1,182 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "aedat.hpp"
-#include "convert.hpp"
+#include "aedat4_writer.hpp"
+#include "bounded_queue.hpp"
+
+// Transcodes an AEDAT 3.1 recording into a compressed AEDAT4 file with a
+// data table. A reader thread walks the memory mapped input and cuts its
+// polarity events into chunks, a pool of encoder threads serializes and
+// compresses the chunks, and the main thread writes them in input order.
+// Both queues are bounded, so memory use does not depend on the size of the
+// recording.
+struct Transcoder {
+  struct Chunk {
+    EventStore events;
+    std::promise<AEDAT4Writer::PendingPacket> packet;
+  };
+
+  size_t events_per_packet = 1 << 14;
+  size_t num_threads = 1;
+  int size_x = 128;
+  int size_y = 128;
+  CompressionType compression = CompressionType_LZ4;
+
+  size_t num_events = 0;
+  size_t num_packets = 0;
+
+  void run(const std::string &input, const std::string &output) {
+    MappedAEDAT reader(input);
+
+    AEDAT4Writer writer;
+    const int32_t stream_id =
+        writer.add_stream(AEDAT4::OutInfo::Type::EVTS, size_x, size_y);
+    writer.open(output, compression);
+
+    // a few chunks per encoder keeps all of them busy
+    const size_t capacity = 4 * num_threads;
+    BoundedQueue<std::unique_ptr<Chunk>> chunks(capacity);
+    BoundedQueue<std::future<AEDAT4Writer::PendingPacket>> order(capacity);
+
+    std::exception_ptr read_error;
+    std::thread read_thread([&] {
+      try {
+        read(reader, chunks, order);
+      } catch (...) {
+        read_error = std::current_exception();
+      }
+      chunks.close();
+      order.close();
+    });
+
+    std::vector<std::thread> encoders;
+    for (size_t t = 0; t < num_threads; t++) {
+      encoders.emplace_back([&, stream_id] { encode(stream_id, chunks); });
+    }
+
+    auto stop = [&] {
+      chunks.close();
+      order.close();
+      read_thread.join();
+      for (auto &encoder : encoders) {
+        encoder.join();
+      }
+    };
+
+    try {
+      std::future<AEDAT4Writer::PendingPacket> packet;
+      while (order.pop(packet)) {
+        auto result = packet.get();
+        num_events += result.num_elements;
+        num_packets++;
+        writer.write_compressed(result);
+      }
+    } catch (...) {
+      stop();
+      throw;
+    }
+    stop();
+
+    if (read_error) {
+      std::rethrow_exception(read_error);
+    }
+    writer.close();
+  }
+
+  // Cuts the polarity events of the input into chunks, queueing the future
+  // result of each chunk in order before handing the chunk to the encoders.
+  void read(MappedAEDAT &reader, BoundedQueue<std::unique_ptr<Chunk>> &chunks,
+            BoundedQueue<std::future<AEDAT4Writer::PendingPacket>> &order) {
+    MappedAEDAT::Packet packet;
+    auto chunk = std::make_unique<Chunk>();
+
+    auto submit = [&] {
+      if (!order.push(chunk->packet.get_future())) {
+        return false;
+      }
+      if (!chunks.push(std::move(chunk))) {
+        return false;
+      }
+      chunk = std::make_unique<Chunk>();
+      return true;
+    };
+
+    while (reader.next(packet)) {
+      auto events = packet.polarity_events();
+      if (events.empty()) {
+        continue;
+      }
+
+      AEDAT::decode_polarity_events(events.data, events.size(),
+                                    packet.overflow, chunk->events);
+
+      if (chunk->events.size() >= events_per_packet && !submit()) {
+        return;
+      }
+    }
+
+    if (!chunk->events.empty()) {
+      submit();
+    }
+  }
+
+  void encode(int32_t stream_id,
+              BoundedQueue<std::unique_ptr<Chunk>> &chunks) {
+    AEDAT4Writer::Compressor compressor(compression);
+    std::unique_ptr<Chunk> chunk;
+    while (chunks.pop(chunk)) {
+      try {
+        auto packet = AEDAT4Writer::event_packet(
+            stream_id, chunk->events, 0, chunk->events.size());
+        compressor.compress(packet.data, packet.compressed);
+        std::vector<uint8_t>().swap(packet.data);
+        chunk->packet.set_value(std::move(packet));
+      } catch (...) {
+        chunk->packet.set_exception(std::current_exception());
+      }
+    }
+  }
+};
 
 int main(int argc, char *argv[]) {
-  AEDAT data;
+  if (argc < 3 || argc > 7) {
+    std::cerr << "usage: " << argv[0]
+              << " input.aedat output.aedat4 [compression] [num_threads]"
+                 " [size_x] [size_y]"
+              << std::endl;
+    return 1;
+  }
 
-  if (argc > 0) {
-    data.load(argv[1]);
-  } else {
-    return 0;
+  Transcoder transcoder;
+  transcoder.num_threads = std::max(1u, std::thread::hardware_concurrency());
+  if (argc > 3) {
+    transcoder.compression = AEDAT4Writer::to_compression(argv[3]);
+  }
+  if (argc > 4) {
+    transcoder.num_threads = std::max(1, std::stoi(argv[4]));
   }
+  if (argc > 5) {
+    transcoder.size_x = std::stoi(argv[5]);
+  }
+  if (argc > 6) {
+    transcoder.size_y = std::stoi(argv[6]);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  transcoder.run(argv[1], argv[2]);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
 
-  auto events = convert_polarity_events(data.polarity_events);
-  std::cout << events.sizes() << std::endl;
-}
\ No newline at end of file
+  std::cout << transcoder.num_events << " events in "
+            << transcoder.num_packets << " packets, " << elapsed.count()
+            << " s" << std::endl;
+}
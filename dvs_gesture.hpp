@@ -1,80 +1,257 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <ostream>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include <dirent.h>
+#include <unistd.h>
+
 #include "aedat.hpp"
+#include "annotations.hpp"
+#include "event_cache.hpp"
+#include "event_store.hpp"
+#include "span.hpp"
 
 namespace dvs_gesture
 {
   struct DataSet
   {
-    struct Row
-    {
-      uint32_t label;
-      uint32_t startTime;
-      uint32_t endTime;
-    };
-
+    // A labelled segment of a recording, viewing its events in an event
+    // store or a mapped cache shared by all segments of the recording, which
+    // the data point keeps alive.
     struct DataPoint
     {
       uint32_t label;
-      std::vector<AEDAT::PolarityEvent> events;
+      // start of the segment, subtracted from the timestamps by events()
+      int64_t start_time;
+
+      DataPoint(uint32_t label, int64_t start_time, Span<int64_t> t,
+                Span<int16_t> x, Span<int16_t> y, Span<uint8_t> p,
+                std::shared_ptr<const void> owner)
+          : label(label), start_time(start_time), t_column(t), x_column(x),
+            y_column(y), p_column(p), owner(std::move(owner))
+      {
+      }
+
+      size_t size() const { return t_column.size(); }
+
+      Span<int64_t> t() const { return t_column; }
+      Span<int16_t> x() const { return x_column; }
+      Span<int16_t> y() const { return y_column; }
+      Span<uint8_t> p() const { return p_column; }
+
+      // Appends the events of the segment to events, keeping their times.
+      void append_to(EventStore &events) const
+      {
+        events.t.insert(events.t.end(), t_column.begin(), t_column.end());
+        events.x.insert(events.x.end(), x_column.begin(), x_column.end());
+        events.y.insert(events.y.end(), y_column.begin(), y_column.end());
+        events.p.insert(events.p.end(), p_column.begin(), p_column.end());
+        events.time_index.clear();
+      }
+
+      // Returns a copy of the events with times relative to start_time.
+      EventStore events() const
+      {
+        EventStore events;
+        events.reserve(size());
+        append_to(events);
+        for (auto &t : events.t)
+        {
+          t -= start_time;
+        }
+        return events;
+      }
+
+    private:
+      Span<int64_t> t_column;
+      Span<int16_t> x_column;
+      Span<int16_t> y_column;
+      Span<uint8_t> p_column;
+      // EventStore or EventCache holding the columns
+      std::shared_ptr<const void> owner;
     };
 
     void load(const std::string &aedat_filename,
               const std::string &labels_filename)
     {
 
-      std::fstream fs;
-      char line[256];
+      Annotations labels(labels_filename);
 
-      fs.open(labels_filename, std::fstream::in);
-      fs.getline(line, 256);
-      std::vector<Row> rows;
+      AEDAT data;
+      data.load(aedat_filename);
 
-      while (!fs.eof())
+      auto store = std::make_shared<const EventStore>(std::move(data.events));
+      for (const auto &segment : labels.segments(store->t))
       {
-        Row row;
-        fs >> row.label;
-        fs.ignore(1);
-        fs >> row.startTime;
-        fs.ignore(1);
-        fs >> row.endTime;
-        fs.ignore(1);
-        rows.push_back(row);
+        const size_t length = segment.size();
+        datapoints.emplace_back(
+            segment.label, segment.start_time,
+            Span<int64_t>{store->t.data() + segment.begin, length},
+            Span<int16_t>{store->x.data() + segment.begin, length},
+            Span<int16_t>{store->y.data() + segment.begin, length},
+            Span<uint8_t>{store->p.data() + segment.begin, length}, store);
       }
-      rows.pop_back();
+    }
 
-      AEDAT data;
-      data.load(aedat_filename);
+    // Loads every recording in directory that has a matching _labels.csv
+    // file, decoding up to num_threads recordings at once (all cores if 0).
+    // If cache_filename names an existing cache it is mapped instead of
+    // parsing the recordings, otherwise the cache is written after loading.
+    // Delete the cache to pick up changes to the directory.
+    void load_directory(const std::string &directory,
+                        const std::string &cache_filename = "",
+                        size_t num_threads = 0)
+    {
+      datapoints.clear();
+      if (!cache_filename.empty() &&
+          access(cache_filename.c_str(), F_OK) == 0)
+      {
+        load_cache(cache_filename);
+        return;
+      }
 
-      size_t event_idx = 0;
-      for (size_t row_idx = 0; row_idx < rows.size(); row_idx++)
+      auto recordings = find_recordings(directory);
+      if (num_threads == 0)
       {
-        auto datapoint = DataPoint{rows[row_idx].label};
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+      }
+      num_threads =
+          std::max<size_t>(1, std::min(num_threads, recordings.size()));
+
+      std::vector<DataSet> parts(recordings.size());
+      std::vector<std::exception_ptr> errors(num_threads);
+      std::vector<std::thread> threads;
+      std::atomic<size_t> next_recording(0);
 
-        while (data.polarity_events[event_idx].timestamp <
-               rows[row_idx].startTime)
+      for (size_t t = 0; t < num_threads; t++)
+      {
+        threads.emplace_back([&, t]
         {
-          event_idx++;
+          try
+          {
+            size_t idx;
+            while ((idx = next_recording++) < recordings.size())
+            {
+              parts[idx].load(recordings[idx].first, recordings[idx].second);
+            }
+          }
+          catch (...)
+          {
+            errors[t] = std::current_exception();
+          }
+        });
+      }
+
+      for (auto &thread : threads)
+      {
+        thread.join();
+      }
+      for (auto &error : errors)
+      {
+        if (error)
+        {
+          std::rethrow_exception(error);
+        }
+      }
+
+      for (auto &part : parts)
+      {
+        std::move(part.datapoints.begin(), part.datapoints.end(),
+                  std::back_inserter(datapoints));
+      }
+
+      if (!cache_filename.empty())
+      {
+        write_cache(cache_filename);
+      }
+    }
+
+    // Returns the recordings in directory paired with their labels files,
+    // sorted by name.
+    static std::vector<std::pair<std::string, std::string>>
+    find_recordings(const std::string &directory)
+    {
+      const std::string extension = ".aedat";
+      std::vector<std::pair<std::string, std::string>> recordings;
+
+      DIR *dir = opendir(directory.c_str());
+      if (dir == nullptr)
+      {
+        throw std::runtime_error("Failed to open directory");
+      }
+
+      while (auto entry = readdir(dir))
+      {
+        std::string name = entry->d_name;
+        if (name.size() <= extension.size() ||
+            name.compare(name.size() - extension.size(), extension.size(),
+                         extension) != 0)
+        {
+          continue;
         }
 
-        while (data.polarity_events[event_idx].timestamp <
-               rows[row_idx].endTime)
+        std::string path = directory + "/" + name;
+        std::string labels =
+            path.substr(0, path.size() - extension.size()) + "_labels.csv";
+        if (access(labels.c_str(), R_OK) == 0)
         {
-          auto event = data.polarity_events[event_idx];
-          event.timestamp -= rows[row_idx].startTime;
-          datapoint.events.push_back(event);
-          event_idx++;
+          recordings.emplace_back(path, labels);
         }
+      }
+      closedir(dir);
+
+      std::sort(recordings.begin(), recordings.end());
+      return recordings;
+    }
+
+    // Writes the data points to an EventCache, one segment per data point.
+    void write_cache(const std::string &cache_filename) const
+    {
+      EventStore events;
+      std::vector<EventCache::Segment> segments;
+
+      size_t num_events = 0;
+      for (const auto &datapoint : datapoints)
+      {
+        num_events += datapoint.size();
+      }
+      events.reserve(num_events);
 
-        // Avoid pushing empty points
-        if (!datapoint.events.empty())
+      for (const auto &datapoint : datapoints)
+      {
+        const size_t offset = events.size();
+        datapoint.append_to(events);
+        segments.push_back(EventCache::Segment{datapoint.label, 0,
+                                               datapoint.start_time, offset,
+                                               events.size()});
+      }
+
+      EventCache::write(cache_filename, events, segments);
+    }
+
+    // Maps a cache written by write_cache. The data points view the mapped
+    // columns, so the file is paged in as they are read rather than copied.
+    void load_cache(const std::string &cache_filename)
+    {
+      auto cache = std::make_shared<const EventCache>(cache_filename);
+
+      datapoints.reserve(datapoints.size() + cache->num_segments());
+      for (size_t idx = 0; idx < cache->num_segments(); idx++)
+      {
+        const auto sample = cache->sample(idx);
+        if (sample.size() > 0)
         {
-          datapoints.push_back(datapoint);
+          datapoints.emplace_back(sample.label, sample.start_time, sample.t,
+                                  sample.x, sample.y, sample.p, cache);
         }
       }
     }
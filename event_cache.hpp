@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "annotations.hpp"
+#include "event_store.hpp"
+#include "mapped_file.hpp"
+#include "span.hpp"
+#include "time_index.hpp"
+
+// Preprocessed events in a compact columnar file that is memory mapped
+// instead of parsed. The file holds a header followed by the t, x, y and p
+// columns of all events, the labelled segments of the events and, if the
+// events are sorted by time, the bucket offsets of a TimeIndex over them.
+// Every section is aligned to 64 bytes, so the columns can be used in place.
+struct EventCache {
+  static constexpr size_t alignment = 64;
+  static constexpr uint32_t version = 2;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_events;
+    uint64_t num_segments;
+    uint64_t t_offset;
+    uint64_t x_offset;
+    uint64_t y_offset;
+    uint64_t p_offset;
+    uint64_t segments_offset;
+    int64_t index_granularity;
+    int64_t index_start_time;
+    uint64_t index_size;
+    uint64_t index_offset;
+  };
+
+  // Events [begin, end) with a label, starting at start_time.
+  struct Segment {
+    uint32_t label;
+    uint32_t reserved;
+    int64_t start_time;
+    uint64_t begin;
+    uint64_t end;
+
+    size_t size() const { return end - begin; }
+  };
+
+  struct Sample {
+    uint32_t label;
+    int64_t start_time;
+    Span<int64_t> t;
+    Span<int16_t> x;
+    Span<int16_t> y;
+    Span<uint8_t> p;
+
+    size_t size() const { return t.size(); }
+  };
+
+  // Writes events and their segments. The time index is only written if
+  // the events are sorted by time.
+  static void write(const std::string &filename, const EventStore &events,
+                    const std::vector<Segment> &segments = {},
+                    int64_t granularity = TimeIndex::default_granularity) {
+    for (const auto &segment : segments) {
+      if (segment.begin > segment.end || segment.end > events.size()) {
+        throw std::runtime_error("Invalid cache segment");
+      }
+    }
+
+    std::vector<uint64_t> index;
+    TimeIndex time_index;
+    if (std::is_sorted(events.t.begin(), events.t.end())) {
+      time_index.build(events.t, granularity);
+      index.assign(time_index.offsets.begin(), time_index.offsets.end());
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, magic(), sizeof(header.magic));
+    header.version = version;
+    header.num_events = events.size();
+    header.num_segments = segments.size();
+    header.index_granularity = time_index.granularity;
+    header.index_start_time = time_index.start_time;
+    header.index_size = index.size();
+
+    uint64_t size = align(sizeof(Header));
+    auto section = [&size](uint64_t &offset, size_t bytes) {
+      offset = size;
+      size = align(size + bytes);
+    };
+    section(header.t_offset, events.size() * sizeof(int64_t));
+    section(header.x_offset, events.size() * sizeof(int16_t));
+    section(header.y_offset, events.size() * sizeof(int16_t));
+    section(header.p_offset, events.size() * sizeof(uint8_t));
+    section(header.segments_offset, segments.size() * sizeof(Segment));
+    section(header.index_offset, index.size() * sizeof(uint64_t));
+
+    std::ofstream fs(filename, std::ofstream::binary | std::ofstream::trunc);
+    if (!fs) {
+      throw std::runtime_error("Failed to create cache file");
+    }
+
+    auto write_section = [&fs](uint64_t offset, const void *data,
+                               size_t bytes) {
+      static const char padding[alignment] = {};
+      fs.write(padding, offset - static_cast<uint64_t>(fs.tellp()));
+      fs.write(static_cast<const char *>(data), bytes);
+    };
+    write_section(0, &header, sizeof(header));
+    write_section(header.t_offset, events.t.data(),
+                  events.size() * sizeof(int64_t));
+    write_section(header.x_offset, events.x.data(),
+                  events.size() * sizeof(int16_t));
+    write_section(header.y_offset, events.y.data(),
+                  events.size() * sizeof(int16_t));
+    write_section(header.p_offset, events.p.data(),
+                  events.size() * sizeof(uint8_t));
+    write_section(header.segments_offset, segments.data(),
+                  segments.size() * sizeof(Segment));
+    write_section(header.index_offset, index.data(),
+                  index.size() * sizeof(uint64_t));
+
+    if (!fs.flush()) {
+      throw std::runtime_error("Failed to write cache file");
+    }
+  }
+
+  // Writes events with the segments of the annotations over them.
+  static void write(const std::string &filename, const EventStore &events,
+                    const Annotations &annotations) {
+    std::vector<Segment> segments;
+    for (const auto &segment : annotations.segments(events)) {
+      segments.push_back(Segment{segment.label, 0, segment.start_time,
+                                 segment.begin, segment.end});
+    }
+    write(filename, events, segments);
+  }
+
+  // Maps a cache file. With copy_on_write the columns can be modified in
+  // memory without changing the file.
+  void open(const std::string &filename, bool copy_on_write = false) {
+    file.open(filename, copy_on_write);
+    if (file.size() < sizeof(Header)) {
+      throw std::runtime_error("Invalid cache file");
+    }
+
+    header = reinterpret_cast<const Header *>(file.data());
+    if (std::memcmp(header->magic, magic(), sizeof(header->magic)) != 0 ||
+        header->version != version) {
+      throw std::runtime_error("Invalid cache file");
+    }
+
+    const uint64_t num_events = header->num_events;
+    if (!fits(header->t_offset, num_events, sizeof(int64_t)) ||
+        !fits(header->x_offset, num_events, sizeof(int16_t)) ||
+        !fits(header->y_offset, num_events, sizeof(int16_t)) ||
+        !fits(header->p_offset, num_events, sizeof(uint8_t)) ||
+        !fits(header->segments_offset, header->num_segments,
+              sizeof(Segment)) ||
+        !fits(header->index_offset, header->index_size, sizeof(uint64_t))) {
+      throw std::runtime_error("Truncated cache file");
+    }
+
+    for (const auto &segment : segments()) {
+      if (segment.begin > segment.end || segment.end > num_events) {
+        throw std::runtime_error("Invalid cache segment");
+      }
+    }
+
+    auto index_offsets = index();
+    if (!index_offsets.empty()) {
+      bool valid = header->index_granularity > 0 &&
+                   index_offsets[index_offsets.size() - 1] == num_events;
+      for (size_t idx = 1; valid && idx < index_offsets.size(); idx++) {
+        valid = index_offsets[idx - 1] <= index_offsets[idx];
+      }
+      if (!valid) {
+        throw std::runtime_error("Invalid cache time index");
+      }
+    }
+  }
+
+  size_t num_events() const { return header->num_events; }
+  size_t num_segments() const { return header->num_segments; }
+
+  Span<int64_t> t() const { return column<int64_t>(header->t_offset); }
+  Span<int16_t> x() const { return column<int16_t>(header->x_offset); }
+  Span<int16_t> y() const { return column<int16_t>(header->y_offset); }
+  Span<uint8_t> p() const { return column<uint8_t>(header->p_offset); }
+
+  Span<Segment> segments() const {
+    return section<Segment>(header->segments_offset, header->num_segments);
+  }
+
+  Span<uint64_t> index() const {
+    return section<uint64_t>(header->index_offset, header->index_size);
+  }
+
+  bool has_index() const { return header->index_size > 0; }
+
+  Sample sample(size_t idx) const {
+    const Segment &segment = segments()[idx];
+    const size_t length = segment.size();
+    return Sample{segment.label,
+                  segment.start_time,
+                  {t().data + segment.begin, length},
+                  {x().data + segment.begin, length},
+                  {y().data + segment.begin, length},
+                  {p().data + segment.begin, length}};
+  }
+
+  // Returns the offset of the first event at or after time, reading only
+  // the bucket of the time index that contains it.
+  size_t lower_bound(int64_t time) const {
+    if (!has_index()) {
+      throw std::runtime_error("Cache has no time index");
+    }
+    return TimeIndex::lookup(t().data, num_events(), index().data,
+                             header->index_size, header->index_start_time,
+                             header->index_granularity, time);
+  }
+
+  // Returns the range of events [first, last) with times in [start, end).
+  std::pair<size_t, size_t> range(int64_t start, int64_t end) const {
+    const size_t first = lower_bound(start);
+    return {first, std::max(first, lower_bound(end))};
+  }
+
+  EventCache() {}
+  EventCache(const std::string &filename, bool copy_on_write = false) {
+    open(filename, copy_on_write);
+  }
+
+  MappedFile file;
+  const Header *header = nullptr;
+
+private:
+  static const char *magic() { return "AEDATEVC"; }
+
+  static uint64_t align(uint64_t offset) {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+
+  bool fits(uint64_t offset, uint64_t count, size_t element_size) const {
+    return offset % alignment == 0 && offset <= file.size() &&
+           count <= (file.size() - offset) / element_size;
+  }
+
+  template <typename T> Span<T> section(uint64_t offset, size_t count) const {
+    return Span<T>{reinterpret_cast<const T *>(file.data() + offset), count};
+  }
+
+  template <typename T> Span<T> column(uint64_t offset) const {
+    return section<T>(offset, header->num_events);
+  }
+};
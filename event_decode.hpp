@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AEDAT_X86 1
+#endif
+
+#include "events_generated.h"
+
+// Transposes packed AEDAT4 events into separate t, x, y and polarity
+// columns. An Event is 16 bytes: t (8), x (2), y (2), on (1) and three bytes
+// of padding, so the columns can be gathered with a few byte shuffles per
+// event instead of going through the flatbuffers accessors one by one.
+namespace event_decode {
+
+inline void decode_scalar(const Event *events, size_t count, int64_t *t,
+                          int16_t *x, int16_t *y, uint8_t *p) {
+  for (size_t i = 0; i < count; i++) {
+    t[i] = events[i].t();
+    x[i] = events[i].x();
+    y[i] = events[i].y();
+    p[i] = events[i].on();
+  }
+}
+
+#ifdef AEDAT_X86
+// Moves x, y and on of the two events in each 128 bit lane into the first
+// three 32 bit words of that lane.
+#define AEDAT_SHUFFLE_XYP                                                      \
+  0, 1, 8, 9, 2, 3, 10, 11, 4, 12, -1, -1, -1, -1, -1, -1
+
+__attribute__((target("ssse3"))) inline void
+decode_ssse3(const Event *events, size_t count, int64_t *t, int16_t *x,
+             int16_t *y, uint8_t *p) {
+  const __m128i shuffle = _mm_setr_epi8(AEDAT_SHUFFLE_XYP);
+  auto src = reinterpret_cast<const __m128i *>(events);
+
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m128i a = _mm_loadu_si128(src + i);
+    __m128i b = _mm_loadu_si128(src + i + 1);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(t + i),
+                     _mm_unpacklo_epi64(a, b));
+
+    __m128i xyp = _mm_shuffle_epi8(_mm_unpackhi_epi64(a, b), shuffle);
+    uint32_t xs = _mm_cvtsi128_si32(xyp);
+    uint32_t ys = _mm_cvtsi128_si32(_mm_srli_si128(xyp, 4));
+    uint16_t ps = _mm_cvtsi128_si32(_mm_srli_si128(xyp, 8));
+    std::memcpy(x + i, &xs, 4);
+    std::memcpy(y + i, &ys, 4);
+    std::memcpy(p + i, &ps, 2);
+  }
+  decode_scalar(events + i, count - i, t + i, x + i, y + i, p + i);
+}
+
+__attribute__((target("avx2"))) inline void
+decode_avx2(const Event *events, size_t count, int64_t *t, int16_t *x,
+            int16_t *y, uint8_t *p) {
+  const __m256i shuffle =
+      _mm256_setr_epi8(AEDAT_SHUFFLE_XYP, AEDAT_SHUFFLE_XYP);
+  const __m256i gather = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  auto src = reinterpret_cast<const __m256i *>(events);
+
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    // a holds events i and i + 1, b holds i + 2 and i + 3
+    __m256i a = _mm256_loadu_si256(src + i / 2);
+    __m256i b = _mm256_loadu_si256(src + i / 2 + 1);
+
+    // unpacking interleaves the lanes as i, i + 2, i + 1, i + 3
+    __m256i ts = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b),
+                                          _MM_SHUFFLE(3, 1, 2, 0));
+    __m256i rest = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b),
+                                            _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(t + i), ts);
+
+    // 64 bit words of xyp: x[i..i+3], y[i..i+3], on of two events per half
+    __m256i xyp = _mm256_permutevar8x32_epi32(
+        _mm256_shuffle_epi8(rest, shuffle), gather);
+    __m128i xy = _mm256_castsi256_si128(xyp);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(x + i), xy);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(y + i),
+                     _mm_unpackhi_epi64(xy, xy));
+
+    uint64_t on = _mm256_extract_epi64(xyp, 2);
+    uint32_t ps = (on & 0xFFFF) | ((on >> 16) & 0xFFFF0000);
+    std::memcpy(p + i, &ps, 4);
+  }
+  decode_ssse3(events + i, count - i, t + i, x + i, y + i, p + i);
+}
+#undef AEDAT_SHUFFLE_XYP
+#endif
+
+// Decodes count events into the given columns using the widest instruction
+// set supported by the CPU.
+inline void decode(const Event *events, size_t count, int64_t *t, int16_t *x,
+                   int16_t *y, uint8_t *p) {
+#ifdef AEDAT_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+  if (has_avx2) {
+    decode_avx2(events, count, t, x, y, p);
+    return;
+  } else if (has_ssse3) {
+    decode_ssse3(events, count, t, x, y, p);
+    return;
+  }
+#endif
+  decode_scalar(events, count, t, x, y, p);
+}
+
+// Appends the events of a packet to the given columns.
+inline void decode(const EventPacket *packet, std::vector<int64_t> &t,
+                   std::vector<int16_t> &x, std::vector<int16_t> &y,
+                   std::vector<uint8_t> &p) {
+  auto elements = packet->elements();
+  // writers may omit an empty elements vector
+  if (elements == nullptr) {
+    return;
+  }
+  const size_t count = elements->size();
+  const size_t offset = t.size();
+
+  t.resize(offset + count);
+  x.resize(offset + count);
+  y.resize(offset + count);
+  p.resize(offset + count);
+  decode(reinterpret_cast<const Event *>(elements->Data()), count,
+         t.data() + offset, x.data() + offset, y.data() + offset,
+         p.data() + offset);
+}
+
+} // namespace event_decode
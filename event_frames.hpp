@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "event_store.hpp"
+
+// Dense representations of polarity events. The kernels scatter the events
+// [begin, end) of an EventStore into caller provided, zero initialized
+// arrays laid out as [channel][x][y], matching the (t, x, y) index order of
+// the sparse tensors. Pixel indices are computed a block at a time in
+// vectorizable loops, and large inputs are split between OpenMP threads
+// that scatter into private copies of the output before reducing them.
+namespace event_frames {
+
+// Image size after dividing the event coordinates by scale_x and scale_y.
+struct Grid {
+  int64_t width;
+  int64_t height;
+  double scale_x = 1;
+  double scale_y = 1;
+
+  int64_t pixels() const { return width * height; }
+};
+
+constexpr size_t block_size = 256;
+
+// Computes the pixel index of count events starting at offset, or -1 for
+// events falling outside the grid.
+inline void pixel_indices(const EventStore &events, size_t offset,
+                          size_t count, const Grid &grid, int64_t *pixels) {
+  const int16_t *xs = events.x.data() + offset;
+  const int16_t *ys = events.y.data() + offset;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for (size_t i = 0; i < count; i++) {
+    const int64_t x = static_cast<int64_t>(xs[i] / grid.scale_x);
+    const int64_t y = static_cast<int64_t>(ys[i] / grid.scale_y);
+    const bool inside = x >= 0 && x < grid.width && y >= 0 && y < grid.height;
+    pixels[i] = inside ? x * grid.height + y : -1;
+  }
+}
+
+// Runs scatter(begin, end, output) over [begin, end). With OpenMP and more
+// events than output elements, each thread scatters a chunk into its own
+// copy of the output, initialized to identity, and the copies are folded
+// into output with combine.
+template <typename T, typename Scatter, typename Combine>
+void scatter_parallel(size_t begin, size_t end, T *output, size_t size,
+                      T identity, Scatter &&scatter, Combine &&combine) {
+#ifdef _OPENMP
+  const size_t num_threads = std::min<size_t>(
+      omp_get_max_threads(), (end - begin) / std::max<size_t>(size, 1));
+  if (num_threads > 1) {
+    std::vector<std::vector<T>> partials(num_threads);
+#pragma omp parallel for num_threads(num_threads)
+    for (size_t thread = 0; thread < num_threads; thread++) {
+      partials[thread].assign(size, identity);
+      const size_t chunk = (end - begin + num_threads - 1) / num_threads;
+      const size_t chunk_begin = std::min(end, begin + thread * chunk);
+      const size_t chunk_end = std::min(end, chunk_begin + chunk);
+      scatter(chunk_begin, chunk_end, partials[thread].data());
+    }
+
+#pragma omp parallel for simd
+    for (size_t i = 0; i < size; i++) {
+      T value = output[i];
+      for (const auto &partial : partials) {
+        value = combine(value, partial[i]);
+      }
+      output[i] = value;
+    }
+    return;
+  }
+#endif
+  scatter(begin, end, output);
+}
+
+// Counts the events per polarity and pixel into output[2][width][height].
+inline void histogram(const EventStore &events, size_t begin, size_t end,
+                      const Grid &grid, float *output) {
+  auto scatter = [&](size_t first, size_t last, float *counts) {
+    int64_t pixels[block_size];
+    for (size_t offset = first; offset < last; offset += block_size) {
+      const size_t count = std::min(block_size, last - offset);
+      pixel_indices(events, offset, count, grid, pixels);
+      for (size_t i = 0; i < count; i++) {
+        if (pixels[i] >= 0) {
+          const int64_t channel = events.p[offset + i] != 0;
+          counts[channel * grid.pixels() + pixels[i]] += 1;
+        }
+      }
+    }
+  };
+  scatter_parallel(begin, end, output, 2 * grid.pixels(), 0.0f, scatter,
+                   [](float a, float b) { return a + b; });
+}
+
+// Accumulates the event polarities, +1 or -1, into output[num_bins][width]
+// [height]. Event times are mapped linearly from their minimum and maximum
+// onto [0, num_bins - 1] and each event is split between its two
+// neighbouring bins by its distance to them. The events need not be sorted.
+inline void voxel_grid(const EventStore &events, size_t begin, size_t end,
+                       size_t num_bins, const Grid &grid, float *output) {
+  if (begin >= end || num_bins == 0) {
+    return;
+  }
+
+  const auto bounds = std::minmax_element(events.t.begin() + begin,
+                                          events.t.begin() + end);
+  const int64_t first_time = *bounds.first;
+  const int64_t duration = *bounds.second - first_time;
+  const double normalize =
+      duration > 0 ? static_cast<double>(num_bins - 1) / duration : 0;
+  const int64_t last_bin = static_cast<int64_t>(num_bins) - 1;
+
+  auto scatter = [&](size_t first, size_t last, float *voxels) {
+    int64_t pixels[block_size];
+    int64_t bins[block_size];
+    float weights[block_size];
+    for (size_t offset = first; offset < last; offset += block_size) {
+      const size_t count = std::min(block_size, last - offset);
+      pixel_indices(events, offset, count, grid, pixels);
+
+      const int64_t *ts = events.t.data() + offset;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for (size_t i = 0; i < count; i++) {
+        const double time = (ts[i] - first_time) * normalize;
+        const double bin = std::floor(time);
+        // clamped against rounding at both ends of the range
+        bins[i] = std::min(std::max(static_cast<int64_t>(bin), int64_t(0)),
+                           last_bin);
+        weights[i] = static_cast<float>(
+            std::min(std::max(time - bins[i], 0.0), 1.0));
+      }
+
+      for (size_t i = 0; i < count; i++) {
+        if (pixels[i] < 0) {
+          continue;
+        }
+        const float polarity = events.p[offset + i] ? 1.0f : -1.0f;
+        float *voxel = voxels + bins[i] * grid.pixels() + pixels[i];
+        voxel[0] += polarity * (1 - weights[i]);
+        if (bins[i] < last_bin) {
+          voxel[grid.pixels()] += polarity * weights[i];
+        }
+      }
+    }
+  };
+  scatter_parallel(begin, end, output, num_bins * grid.pixels(), 0.0f,
+                   scatter, [](float a, float b) { return a + b; });
+}
+
+// Writes exp(-(t_end - t_last) / tau) into output[2][width][height], where
+// t_last is the time of the latest event of a polarity at a pixel and t_end
+// the time of the latest event overall. Pixels without events stay zero.
+inline void time_surface(const EventStore &events, size_t begin, size_t end,
+                         double tau, const Grid &grid, float *output) {
+  if (begin >= end) {
+    return;
+  }
+
+  const size_t size = 2 * grid.pixels();
+  const int64_t never = std::numeric_limits<int64_t>::min();
+  std::vector<int64_t> latest(size, never);
+
+  // events may be out of order, so keep the maximum instead of the last write
+  auto scatter = [&](size_t first, size_t last, int64_t *times) {
+    int64_t pixels[block_size];
+    for (size_t offset = first; offset < last; offset += block_size) {
+      const size_t count = std::min(block_size, last - offset);
+      pixel_indices(events, offset, count, grid, pixels);
+      for (size_t i = 0; i < count; i++) {
+        if (pixels[i] >= 0) {
+          const int64_t channel = events.p[offset + i] != 0;
+          int64_t &time = times[channel * grid.pixels() + pixels[i]];
+          time = std::max(time, events.t[offset + i]);
+        }
+      }
+    }
+  };
+  scatter_parallel(begin, end, latest.data(), size, never, scatter,
+                   [](int64_t a, int64_t b) { return std::max(a, b); });
+
+  const int64_t reference = *std::max_element(events.t.begin() + begin,
+                                              events.t.begin() + end);
+  const double rate = 1 / tau;
+  const int64_t *times = latest.data();
+#ifdef _OPENMP
+#pragma omp parallel for simd
+#endif
+  for (size_t i = 0; i < size; i++) {
+    output[i] = times[i] == never
+                    ? 0.0f
+                    : static_cast<float>(
+                          std::exp((times[i] - reference) * rate));
+  }
+}
+
+} // namespace event_frames
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "span.hpp"
+#include "time_index.hpp"
+
+// Polarity events stored column-wise, one contiguous array per field, so
+// consumers can process a single field without unpacking whole events.
+// The loaders sort and index the timestamps once loaded; time queries fall
+// back to a plain binary search when the events changed size since, which
+// throws if they are no longer sorted. Modifying t in place requires calling
+// index_time again.
+struct EventStore {
+  std::vector<int64_t> t;
+  std::vector<int16_t> x;
+  std::vector<int16_t> y;
+  std::vector<uint8_t> p; // polarity, 0 or 1
+  TimeIndex time_index;
+
+  size_t size() const { return t.size(); }
+  bool empty() const { return t.empty(); }
+
+  void reserve(size_t size) {
+    t.reserve(size);
+    x.reserve(size);
+    y.reserve(size);
+    p.reserve(size);
+  }
+
+  void resize(size_t size) {
+    t.resize(size);
+    x.resize(size);
+    y.resize(size);
+    p.resize(size);
+    time_index.clear();
+  }
+
+  void clear() {
+    t.clear();
+    x.clear();
+    y.clear();
+    p.clear();
+    time_index.clear();
+  }
+
+  void push_back(int64_t timestamp, int16_t x_pos, int16_t y_pos,
+                 bool polarity) {
+    t.push_back(timestamp);
+    x.push_back(x_pos);
+    y.push_back(y_pos);
+    p.push_back(polarity);
+  }
+
+  // Appends the events [begin, end) of other.
+  void append(const EventStore &other, size_t begin, size_t end) {
+    t.insert(t.end(), other.t.begin() + begin, other.t.begin() + end);
+    x.insert(x.end(), other.x.begin() + begin, other.x.begin() + end);
+    y.insert(y.end(), other.y.begin() + begin, other.y.begin() + end);
+    p.insert(p.end(), other.p.begin() + begin, other.p.begin() + end);
+    time_index.clear();
+  }
+
+  void append(const EventStore &other) { append(other, 0, other.size()); }
+
+  // Removes the events [begin, end).
+  void erase(size_t begin, size_t end) {
+    t.erase(t.begin() + begin, t.begin() + end);
+    x.erase(x.begin() + begin, x.begin() + end);
+    y.erase(y.begin() + begin, y.begin() + end);
+    p.erase(p.begin() + begin, p.begin() + end);
+    time_index.clear();
+  }
+
+  // Sorts the events by time, keeping the order of simultaneous ones, and
+  // indexes them. Recordings are only unsorted after a timestamp reset or
+  // when merging sources.
+  void index_time(int64_t granularity = TimeIndex::default_granularity) {
+    const auto order = TimeIndex::sorted_order(t);
+    TimeIndex::reorder(t, order);
+    TimeIndex::reorder(x, order);
+    TimeIndex::reorder(y, order);
+    TimeIndex::reorder(p, order);
+    time_index.build(t, granularity);
+  }
+
+  // Returns the offset of the first event at or after time.
+  size_t lower_bound(int64_t time) const {
+    return time_index.lower_bound(t, time);
+  }
+
+  // Returns the range of events [begin, end) in the time window [start, end).
+  std::pair<size_t, size_t> range(int64_t start, int64_t end) const {
+    const size_t begin = lower_bound(start);
+    return {begin, std::max(begin, lower_bound(end))};
+  }
+
+  // Returns a copy of the events [begin, end).
+  EventStore slice(size_t begin, size_t end) const {
+    EventStore events;
+    events.reserve(end - begin);
+    events.append(*this, begin, end);
+    return events;
+  }
+};
+
+// View of the events [begin, end) of an EventStore, which has to outlive it
+// and must not be modified meanwhile.
+struct EventSlice {
+  const EventStore *events = nullptr;
+  size_t begin = 0;
+  size_t end = 0;
+
+  size_t size() const { return end - begin; }
+  bool empty() const { return begin == end; }
+
+  Span<int64_t> t() const { return column(events->t); }
+  Span<int16_t> x() const { return column(events->x); }
+  Span<int16_t> y() const { return column(events->y); }
+  Span<uint8_t> p() const { return column(events->p); }
+
+  EventStore copy() const { return events->slice(begin, end); }
+
+private:
+  template <typename T> Span<T> column(const std::vector<T> &values) const {
+    return Span<T>{values.data() + begin, size()};
+  }
+};
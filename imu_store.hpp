@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "imus_generated.h"
+#include "time_index.hpp"
+
+// IMU samples stored column-wise like EventStore, with the timestamps in
+// microseconds, accelerations in g, angular velocities in deg/s, the
+// magnetic field in uT and the temperature in degrees Celsius. Samples are
+// sorted by time and indexed the same way as events.
+struct ImuStore {
+  std::vector<int64_t> t;
+  std::vector<float> accelerometer_x;
+  std::vector<float> accelerometer_y;
+  std::vector<float> accelerometer_z;
+  std::vector<float> gyroscope_x;
+  std::vector<float> gyroscope_y;
+  std::vector<float> gyroscope_z;
+  std::vector<float> magnetometer_x;
+  std::vector<float> magnetometer_y;
+  std::vector<float> magnetometer_z;
+  std::vector<float> temperature;
+  TimeIndex time_index;
+
+  static constexpr size_t num_float_columns = 10;
+
+  size_t size() const { return t.size(); }
+  bool empty() const { return t.empty(); }
+
+  // Returns float column idx in declaration order, for operations that treat
+  // all columns alike.
+  std::vector<float> *float_column(size_t idx) {
+    std::vector<float> *columns[num_float_columns] = {
+        &accelerometer_x, &accelerometer_y, &accelerometer_z,
+        &gyroscope_x,     &gyroscope_y,     &gyroscope_z,
+        &magnetometer_x,  &magnetometer_y,  &magnetometer_z,
+        &temperature};
+    return columns[idx];
+  }
+
+  const std::vector<float> *float_column(size_t idx) const {
+    return const_cast<ImuStore *>(this)->float_column(idx);
+  }
+
+  static const char *float_column_name(size_t idx) {
+    static const char *names[num_float_columns] = {
+        "accelerometer_x", "accelerometer_y", "accelerometer_z",
+        "gyroscope_x",     "gyroscope_y",     "gyroscope_z",
+        "magnetometer_x",  "magnetometer_y",  "magnetometer_z",
+        "temperature"};
+    return names[idx];
+  }
+
+  void reserve(size_t size) {
+    t.reserve(size);
+    for (size_t idx = 0; idx < num_float_columns; idx++) {
+      float_column(idx)->reserve(size);
+    }
+  }
+
+  void resize(size_t size) {
+    t.resize(size);
+    for (size_t idx = 0; idx < num_float_columns; idx++) {
+      float_column(idx)->resize(size);
+    }
+    time_index.clear();
+  }
+
+  void clear() {
+    t.clear();
+    for (size_t idx = 0; idx < num_float_columns; idx++) {
+      float_column(idx)->clear();
+    }
+    time_index.clear();
+  }
+
+  // Appends the elements of a decompressed ImuPacket.
+  void append(const ImuPacket *packet) {
+    auto elements = packet->elements();
+    if (elements == nullptr) {
+      return;
+    }
+
+    const size_t offset = size();
+    resize(offset + elements->size());
+    for (size_t i = 0; i < elements->size(); i++) {
+      const Imu *imu = elements->Get(i);
+      const size_t idx = offset + i;
+      t[idx] = imu->t();
+      accelerometer_x[idx] = imu->accelerometer_x();
+      accelerometer_y[idx] = imu->accelerometer_y();
+      accelerometer_z[idx] = imu->accelerometer_z();
+      gyroscope_x[idx] = imu->gyroscope_x();
+      gyroscope_y[idx] = imu->gyroscope_y();
+      gyroscope_z[idx] = imu->gyroscope_z();
+      magnetometer_x[idx] = imu->magnetometer_x();
+      magnetometer_y[idx] = imu->magnetometer_y();
+      magnetometer_z[idx] = imu->magnetometer_z();
+      temperature[idx] = imu->temperature();
+    }
+  }
+
+  // Appends the samples [begin, end) of other.
+  void append(const ImuStore &other, size_t begin, size_t end) {
+    t.insert(t.end(), other.t.begin() + begin, other.t.begin() + end);
+    for (size_t idx = 0; idx < num_float_columns; idx++) {
+      const auto &column = *other.float_column(idx);
+      auto &target = *float_column(idx);
+      target.insert(target.end(), column.begin() + begin,
+                    column.begin() + end);
+    }
+    time_index.clear();
+  }
+
+  void append(const ImuStore &other) { append(other, 0, other.size()); }
+
+  // Removes the samples [begin, end).
+  void erase(size_t begin, size_t end) {
+    t.erase(t.begin() + begin, t.begin() + end);
+    for (size_t idx = 0; idx < num_float_columns; idx++) {
+      auto &column = *float_column(idx);
+      column.erase(column.begin() + begin, column.begin() + end);
+    }
+    time_index.clear();
+  }
+
+  // Sorts the samples by time and indexes them, see EventStore::index_time.
+  void index_time(int64_t granularity = TimeIndex::default_granularity) {
+    const auto order = TimeIndex::sorted_order(t);
+    TimeIndex::reorder(t, order);
+    for (size_t idx = 0; idx < num_float_columns; idx++) {
+      TimeIndex::reorder(*float_column(idx), order);
+    }
+    time_index.build(t, granularity);
+  }
+
+  // Returns the offset of the first sample at or after time.
+  size_t lower_bound(int64_t time) const {
+    return time_index.lower_bound(t, time);
+  }
+
+  // Returns the range of samples [begin, end) in the time window
+  // [start, end).
+  std::pair<size_t, size_t> range(int64_t start, int64_t end) const {
+    const size_t begin = lower_bound(start);
+    return {begin, std::max(begin, lower_bound(end))};
+  }
+
+  // Returns a copy of the samples [begin, end).
+  ImuStore slice(size_t begin, size_t end) const {
+    ImuStore imus;
+    imus.reserve(end - begin);
+    imus.append(*this, begin, end);
+    return imus;
+  }
+};
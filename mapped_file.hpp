@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. Pages are only loaded once they
+// are touched, so opening even very large recordings is cheap.
+struct MappedFile {
+  MappedFile() {}
+  explicit MappedFile(const std::string &filename) { open(filename); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other) noexcept
+      : data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      data_ = other.data_;
+      size_ = other.size_;
+      other.data_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  ~MappedFile() { close(); }
+
+  // With copy_on_write the pages can be written to. Written pages become
+  // private copies, so the file itself never changes.
+  void open(const std::string &filename, bool copy_on_write = false) {
+    struct stat stat_info;
+
+    close();
+
+    auto fd = ::open(filename.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open file");
+    }
+
+    if (fstat(fd, &stat_info)) {
+      ::close(fd);
+      throw std::runtime_error("Failed to stat file");
+    }
+
+    size_ = stat_info.st_size;
+    if (size_ > 0) {
+      void *data =
+          copy_on_write
+              ? mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+              : mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED) {
+        ::close(fd);
+        size_ = 0;
+        throw std::runtime_error("Failed to map file");
+      }
+      data_ = static_cast<const char *>(data);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+  }
+
+  void close() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const char *data() const { return data_; }
+  const char *end() const { return data_ + size_; }
+  size_t size() const { return size_; }
+
+private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
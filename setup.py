@@ -1,9 +1,44 @@
 from setuptools import setup
 import glob
+import os
+import tempfile
+from distutils.ccompiler import new_compiler
+from distutils.errors import CompileError, LinkError
+from distutils.sysconfig import customize_compiler
 from torch.utils.cpp_extension import BuildExtension, CppExtension
 
+
+def openmp_flags():
+    """Returns the OpenMP flags if the compiler supports them, so the frame
+    builders fall back to a single thread otherwise."""
+    compiler = new_compiler()
+    customize_compiler(compiler)
+    with tempfile.TemporaryDirectory() as directory:
+        source = os.path.join(directory, "openmp.c")
+        with open(source, "w") as file:
+            file.write("#include <omp.h>\n"
+                       "int main(void) { return omp_get_max_threads() < 1; }\n")
+        try:
+            objects = compiler.compile([source], output_dir=directory,
+                                       extra_postargs=["-fopenmp"])
+            compiler.link_executable(objects,
+                                     os.path.join(directory, "openmp"),
+                                     extra_postargs=["-fopenmp"])
+        except (CompileError, LinkError):
+            return []
+    return ["-fopenmp"]
+
+
+openmp = openmp_flags()
+
 setup(
     name="aedat",
-    ext_modules=[CppExtension("aedat", ["convert.cpp",], libraries=["lz4"]),],
+    ext_modules=[CppExtension(
+        "aedat",
+        ["convert.cpp",],
+        libraries=["lz4", "zstd"],
+        extra_compile_args=["-std=c++17"] + openmp,
+        extra_link_args=openmp,
+    ),],
     cmdclass={"build_ext": BuildExtension},
 )
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A time window [start, start + size) together with the range of events
+// [begin, end) falling into it.
+struct Window {
+  int64_t start;
+  size_t begin;
+  size_t end;
+
+  size_t size() const { return end - begin; }
+};
+
+// Returns the windows of window_size microseconds, window_step apart,
+// covering the sorted timestamps t up to the last one. The first window
+// starts at the first timestamp. Both ends of the event range only move
+// forward, so this is a single pass over t no matter how much consecutive
+// windows overlap.
+inline std::vector<Window> sliding_windows(const std::vector<int64_t> &t,
+                                           int64_t window_size,
+                                           int64_t window_step) {
+  std::vector<Window> windows;
+  if (t.empty() || window_size <= 0 || window_step <= 0) {
+    return windows;
+  }
+
+  const int64_t last = t.back();
+  if (last - window_size > t.front()) {
+    windows.reserve((last - window_size - t.front()) / window_step + 1);
+  }
+
+  size_t begin = 0;
+  size_t end = 0;
+  for (int64_t start = t.front(); start < last - window_size;
+       start += window_step) {
+    while (begin < t.size() && t[begin] < start) {
+      begin++;
+    }
+    end = std::max(begin, end);
+    while (end < t.size() && t[end] < start + window_size) {
+      end++;
+    }
+    windows.push_back(Window{start, begin, end});
+  }
+  return windows;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+// Non-owning view over a contiguous range of elements.
+template <typename T> struct Span {
+  const T *data = nullptr;
+  size_t length = 0;
+
+  const T *begin() const { return data; }
+  const T *end() const { return data + length; }
+  const T &operator[](size_t idx) const { return data[idx]; }
+  size_t size() const { return length; }
+  bool empty() const { return length == 0; }
+};
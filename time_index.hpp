@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+// Sparse table from time to event offset for sorted timestamps. Entry k
+// holds the first event at or after start_time + k * granularity, so a
+// lookup only binary searches the events of a single bucket. The table
+// takes one entry per granularity microseconds of the recording, but never
+// more entries than there are events, coarsening the granularity if needed.
+struct TimeIndex {
+  static constexpr int64_t default_granularity = 10000;
+
+  int64_t granularity = default_granularity;
+  int64_t start_time = 0;
+  std::vector<size_t> offsets;
+  size_t num_events = 0;
+
+  // Indexes the sorted timestamps t with a single pass over them. The
+  // stores sort their columns with sorted_order before indexing.
+  void build(const std::vector<int64_t> &t,
+             int64_t bucket_size = default_granularity) {
+    clear();
+    granularity = std::max<int64_t>(bucket_size, 1);
+    if (t.empty()) {
+      return;
+    }
+    check_sorted(t);
+    num_events = t.size();
+
+    // more buckets than events only cost memory
+    const int64_t duration = t.back() - t.front();
+    granularity = std::max<int64_t>(
+        granularity, duration / static_cast<int64_t>(t.size()) + 1);
+
+    start_time = t.front();
+    const size_t num_buckets = (t.back() - start_time) / granularity + 1;
+    offsets.resize(num_buckets + 1);
+
+    size_t idx = 0;
+    for (size_t bucket = 0; bucket < num_buckets; bucket++) {
+      const int64_t time = start_time + bucket * granularity;
+      while (t[idx] < time) {
+        idx++;
+      }
+      offsets[bucket] = idx;
+    }
+    offsets[num_buckets] = t.size();
+  }
+
+  void clear() {
+    offsets.clear();
+    num_events = 0;
+  }
+
+  // Returns whether the index was built for timestamps of the size of t.
+  bool indexes(const std::vector<int64_t> &t) const {
+    return !offsets.empty() && num_events == t.size();
+  }
+
+  // Returns the offset of the first event at or after time, falling back to
+  // a binary search over all of t if the index does not match it. The
+  // fallback checks that t is sorted, since a binary search over unsorted
+  // timestamps silently returns wrong offsets.
+  size_t lower_bound(const std::vector<int64_t> &t, int64_t time) const {
+    if (!indexes(t)) {
+      check_sorted(t);
+      return std::lower_bound(t.begin(), t.end(), time) - t.begin();
+    }
+    return lookup(t.data(), t.size(), offsets.data(), offsets.size(),
+                  start_time, granularity, time);
+  }
+
+  // Looks up time in an index stored elsewhere, such as in a file, given
+  // its bucket offsets and the size of the sorted timestamps t.
+  template <typename Offset>
+  static size_t lookup(const int64_t *t, size_t size, const Offset *offsets,
+                       size_t num_offsets, int64_t start_time,
+                       int64_t granularity, int64_t time) {
+    if (time <= start_time) {
+      return 0;
+    }
+
+    const size_t bucket = (time - start_time) / granularity;
+    if (bucket + 1 >= num_offsets) {
+      return size;
+    }
+    return std::lower_bound(t + offsets[bucket], t + offsets[bucket + 1],
+                            time) -
+           t;
+  }
+
+  // Returns the permutation that sorts t by time, keeping the order of
+  // simultaneous events, or an empty vector if t is already sorted.
+  static std::vector<size_t> sorted_order(const std::vector<int64_t> &t) {
+    std::vector<size_t> order;
+    if (std::is_sorted(t.begin(), t.end())) {
+      return order;
+    }
+    order.resize(t.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&t](size_t a, size_t b) { return t[a] < t[b]; });
+    return order;
+  }
+
+  // Rearranges column into the order returned by sorted_order, in place so
+  // that views of its memory stay valid.
+  template <typename T>
+  static void reorder(std::vector<T> &column,
+                      const std::vector<size_t> &order) {
+    if (order.empty()) {
+      return;
+    }
+    std::vector<T> sorted;
+    sorted.reserve(column.size());
+    for (auto idx : order) {
+      sorted.push_back(column[idx]);
+    }
+    std::copy(sorted.begin(), sorted.end(), column.begin());
+  }
+
+private:
+  static void check_sorted(const std::vector<int64_t> &t) {
+    if (!std::is_sorted(t.begin(), t.end())) {
+      throw std::runtime_error("Timestamps are not sorted, call index_time "
+                               "to sort them");
+    }
+  }
+};
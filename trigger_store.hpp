@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "event_store.hpp"
+#include "time_index.hpp"
+#include "trigger_generated.h"
+
+// Trigger signals sorted by time, with the offsets of the triggers of every
+// source kept apart, so that the triggers of one source can be searched
+// without looking at the others. Consecutive triggers of a source delimit
+// intervals, such as the frames of an external camera, whose events are
+// found by two binary searches.
+struct TriggerStore {
+  static constexpr size_t num_sources = TriggerSource_MAX + 1;
+
+  std::vector<int64_t> t;
+  std::vector<uint8_t> source; // TriggerSource
+  // offsets into t of the triggers of each source, built by index()
+  std::vector<size_t> source_offsets[num_sources];
+
+  size_t size() const { return t.size(); }
+  bool empty() const { return t.empty(); }
+
+  void reserve(size_t size) {
+    t.reserve(size);
+    source.reserve(size);
+  }
+
+  void clear() {
+    t.clear();
+    source.clear();
+    clear_index();
+  }
+
+  void push_back(int64_t timestamp, TriggerSource trigger_source) {
+    t.push_back(timestamp);
+    source.push_back(static_cast<uint8_t>(trigger_source));
+    indexed = false;
+  }
+
+  // Appends the elements of a decompressed TriggerPacket.
+  void append(const TriggerPacket *packet) {
+    auto elements = packet->elements();
+    if (elements == nullptr) {
+      return;
+    }
+
+    reserve(size() + elements->size());
+    for (auto trigger : *elements) {
+      push_back(trigger->t(), trigger->source());
+    }
+  }
+
+  // Appends the triggers [begin, end) of other.
+  void append(const TriggerStore &other, size_t begin, size_t end) {
+    t.insert(t.end(), other.t.begin() + begin, other.t.begin() + end);
+    source.insert(source.end(), other.source.begin() + begin,
+                  other.source.begin() + end);
+    clear_index();
+  }
+
+  void append(const TriggerStore &other) { append(other, 0, other.size()); }
+
+  // Removes the triggers [begin, end).
+  void erase(size_t begin, size_t end) {
+    t.erase(t.begin() + begin, t.begin() + end);
+    source.erase(source.begin() + begin, source.begin() + end);
+    clear_index();
+  }
+
+  // Sorts the triggers by time, keeping the order of simultaneous ones,
+  // and collects the offsets of each source.
+  void index() {
+    const auto order = TimeIndex::sorted_order(t);
+    TimeIndex::reorder(t, order);
+    TimeIndex::reorder(source, order);
+
+    clear_index();
+    for (size_t idx = 0; idx < size(); idx++) {
+      if (source[idx] < num_sources) {
+        source_offsets[source[idx]].push_back(idx);
+      }
+    }
+    indexed = true;
+  }
+
+  // Returns the number of triggers of a source.
+  size_t count(TriggerSource trigger_source) const {
+    return offsets(trigger_source).size();
+  }
+
+  // Returns the time of the k-th trigger of a source.
+  int64_t time(TriggerSource trigger_source, size_t k) const {
+    return t[offsets(trigger_source).at(k)];
+  }
+
+  // Returns the index k of the last trigger of a source at or before time,
+  // or -1 if there is none.
+  int64_t interval(TriggerSource trigger_source, int64_t time) const {
+    const auto &offsets = this->offsets(trigger_source);
+    auto next = std::upper_bound(
+        offsets.begin(), offsets.end(), time,
+        [this](int64_t value, size_t idx) { return value < t[idx]; });
+    return static_cast<int64_t>(next - offsets.begin()) - 1;
+  }
+
+  // Returns the range of events [begin, end) from the k-th trigger of a
+  // source up to the next one.
+  std::pair<size_t, size_t> events_between(const EventStore &events,
+                                           TriggerSource trigger_source,
+                                           size_t k) const {
+    if (k + 1 >= count(trigger_source)) {
+      throw std::out_of_range("No trigger after trigger " +
+                              std::to_string(k));
+    }
+    return events.range(time(trigger_source, k),
+                        time(trigger_source, k + 1));
+  }
+
+  // Returns the ranges of events between every two consecutive triggers of
+  // a source.
+  std::vector<std::pair<size_t, size_t>>
+  events_between(const EventStore &events,
+                 TriggerSource trigger_source) const {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    const size_t num_triggers = count(trigger_source);
+    for (size_t k = 0; k + 1 < num_triggers; k++) {
+      ranges.push_back(events_between(events, trigger_source, k));
+    }
+    return ranges;
+  }
+
+  static TriggerSource to_source(const std::string &str) {
+    for (auto trigger_source : EnumValuesTriggerSource()) {
+      if (str == EnumNameTriggerSource(trigger_source)) {
+        return trigger_source;
+      }
+    }
+    throw std::runtime_error("unexpected trigger source " + str);
+  }
+
+  // Returns the offsets of the triggers of a source. index() has to be
+  // called after changing the triggers; the loaders do this.
+  const std::vector<size_t> &offsets(TriggerSource trigger_source) const {
+    if (trigger_source < 0 ||
+        static_cast<size_t>(trigger_source) >= num_sources) {
+      throw std::runtime_error("unexpected trigger source");
+    }
+    if (!indexed && !empty()) {
+      throw std::runtime_error("Triggers are not indexed");
+    }
+    return source_offsets[trigger_source];
+  }
+
+private:
+  void clear_index() {
+    for (auto &offsets : source_offsets) {
+      offsets.clear();
+    }
+    indexed = false;
+  }
+
+  bool indexed = false;
+};
@@ -3,9 +3,11 @@
 #include "dvs_gesture.hpp"
 
 #include <SDL.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <vector>
 
 uint32_t render_frame(SDL_Renderer *renderer, SDL_Texture *frame_texture,
@@ -26,27 +28,28 @@ uint32_t render_frame(SDL_Renderer *renderer, SDL_Texture *frame_texture,
   return frame_index;
 }
 
-uint32_t
-render_polarity_events(SDL_Renderer *renderer,
-                       std::vector<AEDAT::PolarityEvent> &polarity_events,
-                       SDL_Point top, uint32_t event_index, uint32_t timestep) {
+uint32_t render_polarity_events(SDL_Renderer *renderer,
+                                const dvs_gesture::DataSet::DataPoint &events,
+                                SDL_Point top, uint32_t event_index,
+                                int64_t timestep) {
   std::vector<SDL_Point> positive_polarity_points;
   std::vector<SDL_Point> negative_polarity_points;
 
-  if (event_index >= polarity_events.size()) {
+  if (event_index >= events.size()) {
     return 0;
   }
 
-  while ((polarity_events[event_index].timestamp < timestep) &&
-         (event_index < polarity_events.size())) {
-    if (polarity_events[event_index].polarity == 1) {
+  const auto t = events.t();
+  const auto x = events.x();
+  const auto y = events.y();
+  const auto p = events.p();
+  while ((event_index < events.size()) && (t[event_index] < timestep)) {
+    if (p[event_index] == 1) {
       positive_polarity_points.push_back(
-          {top.x + polarity_events[event_index].x,
-           top.y + polarity_events[event_index].y});
+          {top.x + x[event_index], top.y + y[event_index]});
     } else {
       negative_polarity_points.push_back(
-          {top.x + polarity_events[event_index].x,
-           top.y + polarity_events[event_index].y});
+          {top.x + x[event_index], top.y + y[event_index]});
     }
     event_index++;
   }
@@ -72,34 +75,50 @@ int main(int argc, char *argv[]) {
   AEDAT4 data4;
   dvs_gesture::DataSet dataset;
   bool gesture_dataset = false;
-  std::vector<std::vector<AEDAT::PolarityEvent>> events;
+  // views of the rendered events, which data4 or dataset keep alive
+  std::vector<dvs_gesture::DataSet::DataPoint> events;
   std::vector<uint32_t> event_index;
-  std::vector<uint32_t> timestep;
+  std::vector<int64_t> timestep;
   int64_t video_timestep;
 
-  if (argc == 2) {
+  struct stat path_info;
+  bool is_directory = argc == 2 && stat(argv[1], &path_info) == 0 &&
+                      S_ISDIR(path_info.st_mode);
+
+  if (argc == 2 && !is_directory) {
     data4.load(argv[1]);
     window_width = data4.outinfos[0].size_x;
     window_height = data4.outinfos[0].size_y;
-    events.push_back(data4.polarity_events);
+    const auto &store = data4.events;
+    events.emplace_back(0, 0, Span<int64_t>{store.t.data(), store.size()},
+                        Span<int16_t>{store.x.data(), store.size()},
+                        Span<int16_t>{store.y.data(), store.size()},
+                        Span<uint8_t>{store.p.data(), store.size()}, nullptr);
     event_index.push_back(0);
     num_row = 1;
     num_column = 1;
     num_classes = 1;
-    timestep.push_back(data4.polarity_events[0].timestamp + 16000);
-  } else if (argc == 3) {
-    dataset.load(argv[1], argv[2]);
+    timestep.push_back(data4.events.t[0] + 16000);
+  } else if (argc == 2 || argc == 3) {
+    if (is_directory) {
+      dataset.load_directory(argv[1]);
+    } else {
+      dataset.load(argv[1], argv[2]);
+    }
     num_row = 3;
     num_column = 4;
     window_width = num_column * 128;
     window_height = num_row * 128;
     num_classes = 11;
 
-    for (auto data : dataset.datapoints) {
-      events.push_back(data.events);
+    // only the data points shown in the grid are kept
+    const size_t num_shown = std::min<size_t>(
+        dataset.datapoints.size(), std::min(num_row * num_column, num_classes));
+    for (size_t idx = 0; idx < num_shown; idx++) {
+      events.push_back(dataset.datapoints[idx]);
       event_index.push_back(0);
 
-      timestep.push_back(data.events[0].timestamp + 16000);
+      timestep.push_back(events.back().t()[0] + 16000);
     }
   } else {
     return 0;
@@ -155,15 +174,14 @@ int main(int argc, char *argv[]) {
 
     for (int i = 0; i < num_row; i++) {
       for (int j = 0; j < num_column; j++) {
-        if (num_column * i + j >= num_classes) {
+        if (num_column * i + j >= static_cast<int>(events.size())) {
           break;
         }
         event_index[num_column * i + j] = render_polarity_events(
             renderer, events[num_column * i + j], {128 * i, 128 * j},
             event_index[num_column * i + j], timestep[num_column * i + j]);
         if (event_index[num_column * i + j] == 0) {
-          timestep[num_column * i + j] =
-              events[num_column * i + j][0].timestamp;
+          timestep[num_column * i + j] = events[num_column * i + j].t()[0];
         }
         timestep[num_column * i + j] += 16000;
       }